@@ -0,0 +1,27 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../search-server/test_example_functions.h"
+
+using namespace std;
+
+// Сверка параллельных версий с последовательными и кривая их ускорения.
+// Отчёт печатается в stdout, а если передан путь, то и сохраняется в файл:
+//     benchmark [файл отчёта]
+int main(int argc, char* argv[]) {
+    DifferentialTestConfig config;
+    config.measure_speedup = true;
+
+    const DifferentialTestReport report = RunDifferentialTest(config);
+    PrintDifferentialTestReport(report);
+    if (argc > 1) {
+        ofstream output(argv[1]);
+        if (!output) {
+            cerr << "Не удалось открыть файл "s << argv[1] << endl;
+            return 1;
+        }
+        PrintDifferentialTestReport(report, output);
+    }
+    return report.mismatch_count == 0 ? 0 : 1;
+}
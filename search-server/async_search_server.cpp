@@ -0,0 +1,73 @@
+#include "async_search_server.h"
+
+#include <algorithm>
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t thread_count)
+    : AsyncSearchServer(search_server, thread_count, std::max<size_t>(thread_count, 1) * DEFAULT_QUEUE_SIZE_PER_THREAD) {
+}
+
+AsyncSearchServer::AsyncSearchServer(const SearchServer& search_server, size_t thread_count, size_t max_queue_size)
+    : search_server_(search_server)
+    , max_queue_size_(max_queue_size) {
+    using namespace std::string_literals;
+    if (thread_count == 0) {
+        throw std::invalid_argument("Кол-во рабочих потоков должно быть положительным"s);
+    }
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+AsyncSearchServer::~AsyncSearchServer() {
+    {
+        std::lock_guard lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::future<DeadlineSearchResult> AsyncSearchServer::FindTopDocuments(std::string raw_query, DocumentStatus status, std::chrono::milliseconds timeout,
+                                                                      QueryMode mode) {
+    return FindTopDocuments(std::move(raw_query), StatusEquals(status), timeout, mode);
+}
+
+std::future<DeadlineSearchResult> AsyncSearchServer::FindTopDocuments(std::string raw_query, std::chrono::milliseconds timeout, QueryMode mode) {
+    return FindTopDocuments(std::move(raw_query), DocumentStatus::ACTUAL, timeout, mode);
+}
+
+std::future<MatchTuple> AsyncSearchServer::MatchDocument(std::string raw_query, int document_id) {
+    return Enqueue<MatchTuple>([this, raw_query = std::move(raw_query), document_id] {
+        return search_server_.MatchDocument(raw_query, document_id);
+    });
+}
+
+size_t AsyncSearchServer::GetQueueSize() const {
+    std::lock_guard lock(queue_mutex_);
+    return tasks_.size();
+}
+
+size_t AsyncSearchServer::GetRejectedCount() const {
+    std::lock_guard lock(queue_mutex_);
+    return rejected_count_;
+}
+
+void AsyncSearchServer::WorkerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        // Исключения запроса сохраняются packaged_task в его future
+        task();
+    }
+}
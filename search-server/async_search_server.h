@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+// Асинхронная обёртка над SearchServer: запросы ставятся в ограниченную очередь
+// и выполняются пулом рабочих потоков, результат возвращается через std::future.
+// Пока существует обёртка, сервер не должен изменяться (AddDocument/RemoveDocument)
+class AsyncSearchServer {
+public:
+    // Размер очереди по умолчанию на один рабочий поток
+    static constexpr size_t DEFAULT_QUEUE_SIZE_PER_THREAD = 64;
+
+    AsyncSearchServer(const SearchServer& search_server, size_t thread_count);
+    AsyncSearchServer(const SearchServer& search_server, size_t thread_count, size_t max_queue_size);
+
+    AsyncSearchServer(const AsyncSearchServer&) = delete;
+    AsyncSearchServer& operator=(const AsyncSearchServer&) = delete;
+
+    // Дожидается выполнения уже принятых запросов
+    ~AsyncSearchServer();
+
+    // Дедлайн отсчитывается с момента постановки запроса в очередь,
+    // т.е. время ожидания в очереди тоже учитывается.
+    // При переполненной очереди запрос отклоняется сразу: бросается std::runtime_error
+    template <typename DocumentPredicate>
+    std::future<DeadlineSearchResult> FindTopDocuments(std::string raw_query, DocumentPredicate document_predicate, std::chrono::milliseconds timeout,
+                                                       QueryMode mode = QueryMode::ANY);
+    std::future<DeadlineSearchResult> FindTopDocuments(std::string raw_query, DocumentStatus status, std::chrono::milliseconds timeout,
+                                                       QueryMode mode = QueryMode::ANY);
+    std::future<DeadlineSearchResult> FindTopDocuments(std::string raw_query, std::chrono::milliseconds timeout, QueryMode mode = QueryMode::ANY);
+
+    std::future<MatchTuple> MatchDocument(std::string raw_query, int document_id);
+
+    // Текущее кол-во запросов, ожидающих выполнения
+    size_t GetQueueSize() const;
+
+    // Кол-во запросов, отклонённых из-за переполнения очереди
+    size_t GetRejectedCount() const;
+
+private:
+    const SearchServer& search_server_;
+    const size_t max_queue_size_;
+
+    mutable std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<std::function<void()>> tasks_;
+    size_t rejected_count_ = 0;
+    bool stopping_ = false;
+
+    std::vector<std::thread> workers_;
+
+    // Ставит задачу в очередь и возвращает её future, либо бросает исключение при переполнении
+    template <typename Result, typename Func>
+    std::future<Result> Enqueue(Func func);
+
+    void WorkerLoop();
+};
+
+template <typename DocumentPredicate>
+std::future<DeadlineSearchResult> AsyncSearchServer::FindTopDocuments(std::string raw_query, DocumentPredicate document_predicate, std::chrono::milliseconds timeout,
+                                                                      QueryMode mode) {
+    const SearchClock::time_point deadline = SearchClock::now() + timeout;
+    return Enqueue<DeadlineSearchResult>([this, raw_query = std::move(raw_query), document_predicate, deadline, mode] {
+        if (SearchClock::now() >= deadline) {
+            // Дедлайн истёк ещё в очереди — не тратим время на ранжирование
+            return DeadlineSearchResult{{}, true};
+        }
+        return search_server_.FindTopDocumentsWithDeadline(raw_query, document_predicate, deadline, mode);
+    });
+}
+
+template <typename Result, typename Func>
+std::future<Result> AsyncSearchServer::Enqueue(Func func) {
+    using namespace std::string_literals;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+    std::future<Result> result = task->get_future();
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (stopping_) {
+            throw std::logic_error("Асинхронный сервер остановлен"s);
+        }
+        if (tasks_.size() >= max_queue_size_) {
+            ++rejected_count_;
+            throw std::runtime_error("Очередь запросов переполнена"s);
+        }
+        tasks_.emplace_back([task] { (*task)(); });
+    }
+    queue_cv_.notify_one();
+    return result;
+}
@@ -53,7 +53,7 @@ public:
     }
     
     void erase(const Key& key) {
-        auto& bucket = bucket_[uint64_t(key) & bucket_.size()];
+        auto& bucket = bucket_[uint64_t(key) % bucket_.size()];
         std::lock_guard lock_guard_mutex(bucket.bucket_mutex_);
         bucket.bucket_map_.erase(key);
     }
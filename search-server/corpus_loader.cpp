@@ -0,0 +1,191 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+// Отделяет от строки поле до символа-разделителя
+std::string_view TakeField(std::string_view& line, char delimiter) {
+    const size_t pos = line.find(delimiter);
+    if (pos == line.npos) {
+        throw std::invalid_argument("В записи корпуса не хватает полей"s);
+    }
+    std::string_view field = line.substr(0, pos);
+    line.remove_prefix(pos + 1);
+    return field;
+}
+
+int ParseInt(std::string_view text) {
+    int result = 0;
+    const auto [ptr, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+    if (error != std::errc() || ptr != text.data() + text.size()) {
+        throw std::invalid_argument("Некорректное число \""s + std::string(text) + "\" в записи корпуса"s);
+    }
+    return result;
+}
+
+DocumentStatus ParseStatus(std::string_view text) {
+    if (text == "ACTUAL") {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT") {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED") {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED") {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("Неизвестный статус документа \""s + std::string(text) + "\""s);
+}
+
+DocumentRecord ParseRecord(std::string_view line) {
+    DocumentRecord record;
+    record.id = ParseInt(TakeField(line, '\t'));
+    record.status = ParseStatus(TakeField(line, '\t'));
+    for (std::string_view rating : SplitIntoWords(TakeField(line, '\t'))) {
+        record.ratings.push_back(ParseInt(rating));
+    }
+    record.text = line;
+    return record;
+}
+
+// Разбор непрерывного фрагмента chunk корпуса data, состоящего из целых строк
+std::vector<DocumentRecord> ParseChunk(std::string_view data, std::string_view chunk) {
+    std::vector<DocumentRecord> records;
+    while (!chunk.empty()) {
+        const size_t line_end = std::min(chunk.find('\n'), chunk.size());
+        std::string_view line = chunk.substr(0, line_end);
+        chunk.remove_prefix(std::min(line_end + 1, chunk.size()));
+
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+            try {
+                records.push_back(ParseRecord(line));
+            } catch (const std::invalid_argument& error) {
+                // Номер строки нужен только для сообщения, поэтому строки считаются лишь при ошибке
+                const size_t offset = static_cast<size_t>(line.data() - data.data());
+                const size_t line_number = static_cast<size_t>(std::count(data.begin(), data.begin() + offset, '\n')) + 1;
+                throw std::invalid_argument("Ошибка в строке "s + std::to_string(line_number) + " корпуса (байт "s
+                                            + std::to_string(offset) + "): "s + error.what());
+            }
+        }
+    }
+    return records;
+}
+
+} // namespace
+
+std::vector<DocumentRecord> ParseCorpus(std::string_view data, size_t thread_count) {
+    // Вызывающий поток тоже разбирает фрагменты, поэтому рабочих потоков на один меньше
+    ThreadPool thread_pool(std::max<size_t>(thread_count, 1) - 1);
+    return ParseCorpus(data, thread_pool);
+}
+
+std::vector<DocumentRecord> ParseCorpus(std::string_view data, ThreadPool& thread_pool) {
+    // Делим корпус на примерно равные фрагменты, выравнивая границы по концам строк.
+    // Фрагментов больше, чем потоков, чтобы простаивающие потоки могли перехватывать работу
+    std::vector<std::string_view> chunks;
+    const size_t chunk_size = data.size() / ((thread_pool.GetThreadCount() + 1) * 4) + 1;
+    size_t chunk_begin = 0;
+    while (chunk_begin < data.size()) {
+        size_t chunk_end = std::min(chunk_begin + chunk_size, data.size());
+        chunk_end = std::min(data.find('\n', chunk_end), data.size());
+        chunks.push_back(data.substr(chunk_begin, chunk_end - chunk_begin));
+        chunk_begin = chunk_end + 1;
+    }
+
+    std::vector<std::vector<DocumentRecord>> chunk_records(chunks.size());
+    thread_pool.ParallelFor(chunks.size(), data.size(), [data, &chunks, &chunk_records](size_t i) {
+        chunk_records[i] = ParseChunk(data, chunks[i]);
+    });
+
+    std::vector<DocumentRecord> records;
+    for (auto& chunk : chunk_records) {
+        records.insert(records.end(), std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+    }
+    return records;
+}
+
+void LoadCorpus(SearchServer& search_server, const std::string& path, size_t thread_count) {
+    ThreadPool thread_pool(std::max<size_t>(thread_count, 1) - 1);
+    LoadCorpus(search_server, path, thread_pool);
+}
+
+void LoadCorpus(SearchServer& search_server, const std::string& path, ThreadPool& thread_pool) {
+    auto mapped_file = std::make_shared<const MappedFile>(path);
+    const std::vector<DocumentRecord> records = ParseCorpus(mapped_file->GetData(), thread_pool);
+    search_server.AddDocuments(thread_pool, std::move(mapped_file), records);
+}
+
+IndexLogReplayError::IndexLogReplayError(const std::string& message, uint64_t last_applied_sequence)
+    : std::runtime_error(message)
+    , last_applied_sequence_(last_applied_sequence) {
+}
+
+uint64_t IndexLogReplayError::GetLastAppliedSequence() const {
+    return last_applied_sequence_;
+}
+
+uint64_t ReplayIndexLog(SearchServer& search_server, const std::string& path, uint64_t after_sequence, ThreadPool& thread_pool) {
+    auto mapped_file = std::make_shared<const MappedFile>(path);
+    const std::vector<IndexLogEntry> entries = ParseIndexLog(mapped_file->GetData(), after_sequence);
+
+    uint64_t last_applied_sequence = after_sequence;
+    // Применяет записи с номерами first_sequence..last_sequence; при ошибке сообщает, докуда журнал применён
+    const auto apply = [&](uint64_t first_sequence, uint64_t last_sequence, auto func) {
+        try {
+            func();
+        } catch (const std::exception& error) {
+            const std::string sequences = first_sequence == last_sequence
+                ? "запись "s + std::to_string(first_sequence)
+                : "записи "s + std::to_string(first_sequence) + "-"s + std::to_string(last_sequence);
+            throw IndexLogReplayError("Не удалось применить "s + sequences + " журнала индекса "s + path + ": "s + error.what(),
+                                      last_applied_sequence);
+        }
+        last_applied_sequence = last_sequence;
+    };
+
+    std::vector<DocumentRecord> records;
+    uint64_t first_record_sequence = 0;
+    const auto add_records = [&] {
+        if (!records.empty()) {
+            apply(first_record_sequence, first_record_sequence + records.size() - 1, [&] {
+                search_server.AddDocuments(thread_pool, mapped_file, records);
+            });
+            records.clear();
+        }
+    };
+    for (const IndexLogEntry& entry : entries) {
+        switch (entry.operation) {
+            case IndexLogOperation::ADD_DOCUMENT:
+                if (records.empty()) {
+                    first_record_sequence = entry.sequence;
+                }
+                records.push_back({entry.document_id, entry.status, entry.ratings, entry.text});
+                break;
+            case IndexLogOperation::REMOVE_DOCUMENT:
+                add_records();
+                apply(entry.sequence, entry.sequence, [&] {
+                    search_server.RemoveDocument(entry.document_id);
+                });
+                break;
+            case IndexLogOperation::SET_DOCUMENT_ATTRIBUTE:
+                add_records();
+                apply(entry.sequence, entry.sequence, [&] {
+                    search_server.SetDocumentAttribute(entry.document_id, entry.attribute_name, entry.attribute_value);
+                });
+                break;
+        }
+    }
+    add_records();
+    return last_applied_sequence;
+}
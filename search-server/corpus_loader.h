@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+#include "search_server.h"
+
+// Разбор корпуса документов. Каждая непустая строка описывает один документ:
+// <id>\t<статус>\t<рейтинги через пробел>\t<текст>
+// Статус записывается именем: ACTUAL, IRRELEVANT, BANNED или REMOVED.
+// Тексты записей ссылаются прямо на data
+std::vector<DocumentRecord> ParseCorpus(std::string_view data, size_t thread_count);
+// То же в потоках thread_pool, например в пуле, отделённом от пула запросов
+std::vector<DocumentRecord> ParseCorpus(std::string_view data, ThreadPool& thread_pool);
+
+// Отображает файл корпуса в память, разбирает его в thread_count потоков
+// и регистрирует документы в сервере без копирования текста.
+// В режиме TextStorageMode::IN_MEMORY отображение живёт столько же, сколько сервер,
+// в остальных режимах освобождается сразу после загрузки
+void LoadCorpus(SearchServer& search_server, const std::string& path, size_t thread_count);
+// То же в потоках thread_pool; в них же тексты разбираются на слова (см. SearchServer::AddDocuments)
+void LoadCorpus(SearchServer& search_server, const std::string& path, ThreadPool& thread_pool);
+
+// Ошибка воспроизведения журнала индекса. Записи с номерами до GetLastAppliedSequence() включительно
+// уже применены, а следующие — нет, поэтому после устранения причины воспроизведение продолжают,
+// передав этот номер как after_sequence
+class IndexLogReplayError : public std::runtime_error {
+public:
+    IndexLogReplayError(const std::string& message, uint64_t last_applied_sequence);
+
+    uint64_t GetLastAppliedSequence() const;
+
+private:
+    uint64_t last_applied_sequence_;
+};
+
+// Применяет к серверу записи журнала индекса (см. IndexLog) с номерами больше after_sequence,
+// например поверх состояния, загруженного из снимка. Подряд идущие добавления применяются
+// одной пачкой с разбором текстов в потоках thread_pool. Файл отображается в память так же,
+// как в LoadCorpus, и может одновременно дописываться: недописанные записи пропускаются.
+// Если к серверу подключён журнал, применённые изменения попадут и в него,
+// поэтому тот же файл подключают уже после воспроизведения.
+// Возвращает номер последней применённой записи (after_sequence, если применять нечего).
+// Если запись применить не удалось, бросает IndexLogReplayError; пачка добавлений при этом
+// не применяется целиком (см. SearchServer::AddDocuments)
+uint64_t ReplayIndexLog(SearchServer& search_server, const std::string& path, uint64_t after_sequence, ThreadPool& thread_pool);
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+// Метаданные документов по столбцам. Строка — внутренний номер документа в сервере,
+// поэтому фильтр по метаданным читает подряд лежащие массивы, а не ищет документ в дереве
+struct DocumentColumns {
+    std::vector<int> ids;
+    std::vector<DocumentStatus> statuses;
+    std::vector<int> ratings;
+    // Дополнительные числовые атрибуты (например, время публикации): имя -> столбец.
+    // У документов, которым значение не задано, в столбце 0
+    std::map<std::string, std::vector<int64_t>, std::less<>> attributes;
+
+    // Возвращает номер добавленной строки
+    uint32_t Append(int id, DocumentStatus status, int rating) {
+        ids.push_back(id);
+        statuses.push_back(status);
+        ratings.push_back(rating);
+        for (auto& [_, values] : attributes) {
+            values.push_back(0);
+        }
+        return static_cast<uint32_t>(ids.size() - 1);
+    }
+
+    size_t GetRowCount() const {
+        return ids.size();
+    }
+};
+
+// Сколько документов фильтр обрабатывает за один вызов
+constexpr size_t FILTER_BLOCK_SIZE = 256;
+
+// Базовый класс фильтров. Фильтр вычисляется сразу для блока строк:
+// EvaluateBlock(columns, rows, count, mask) записывает в mask[i], подходит ли строка rows[i].
+// Фильтры комбинируются операторами &&, || и ! в шаблонное выражение,
+// которое компилятор разворачивает в простые циклы по блоку без косвенных вызовов
+struct DocumentFilter {
+};
+
+class StatusEquals : public DocumentFilter {
+public:
+    explicit StatusEquals(DocumentStatus status)
+        : status_(status) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        const DocumentStatus* statuses = columns.statuses.data();
+        for (size_t i = 0; i < count; ++i) {
+            mask[i] = statuses[rows[i]] == status_;
+        }
+    }
+
+private:
+    DocumentStatus status_;
+};
+
+// Рейтинг в отрезке [min_rating, max_rating]
+class RatingBetween : public DocumentFilter {
+public:
+    RatingBetween(int min_rating, int max_rating)
+        : min_rating_(min_rating)
+        , max_rating_(max_rating) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        const int* ratings = columns.ratings.data();
+        for (size_t i = 0; i < count; ++i) {
+            const int rating = ratings[rows[i]];
+            mask[i] = rating >= min_rating_ && rating <= max_rating_;
+        }
+    }
+
+private:
+    int min_rating_;
+    int max_rating_;
+};
+
+class IdIsEven : public DocumentFilter {
+public:
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        const int* ids = columns.ids.data();
+        for (size_t i = 0; i < count; ++i) {
+            mask[i] = ids[rows[i]] % 2 == 0;
+        }
+    }
+};
+
+// ID в отрезке [min_id, max_id]
+class IdInRange : public DocumentFilter {
+public:
+    IdInRange(int min_id, int max_id)
+        : min_id_(min_id)
+        , max_id_(max_id) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        const int* ids = columns.ids.data();
+        for (size_t i = 0; i < count; ++i) {
+            const int id = ids[rows[i]];
+            mask[i] = id >= min_id_ && id <= max_id_;
+        }
+    }
+
+private:
+    int min_id_;
+    int max_id_;
+};
+
+// Значение атрибута в отрезке [min_value, max_value].
+// Атрибут, не заданный ни одному документу, считается равным 0 у всех
+class AttributeBetween : public DocumentFilter {
+public:
+    AttributeBetween(std::string name, int64_t min_value, int64_t max_value)
+        : name_(std::move(name))
+        , min_value_(min_value)
+        , max_value_(max_value) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        // Столбец ищется один раз на блок
+        const auto found = columns.attributes.find(name_);
+        if (found == columns.attributes.end()) {
+            for (size_t i = 0; i < count; ++i) {
+                mask[i] = min_value_ <= 0 && max_value_ >= 0;
+            }
+            return;
+        }
+        const int64_t* values = found->second.data();
+        for (size_t i = 0; i < count; ++i) {
+            const int64_t value = values[rows[i]];
+            mask[i] = value >= min_value_ && value <= max_value_;
+        }
+    }
+
+private:
+    std::string name_;
+    int64_t min_value_;
+    int64_t max_value_;
+};
+
+// Обёртка над предикатом вида predicate(document_id, status, rating)
+template <typename DocumentPredicate>
+class PredicateFilter : public DocumentFilter {
+public:
+    explicit PredicateFilter(DocumentPredicate predicate)
+        : predicate_(std::move(predicate)) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t row = rows[i];
+            mask[i] = predicate_(columns.ids[row], columns.statuses[row], columns.ratings[row]);
+        }
+    }
+
+private:
+    DocumentPredicate predicate_;
+};
+
+template <typename Filter>
+constexpr bool IS_DOCUMENT_FILTER = std::is_base_of_v<DocumentFilter, std::decay_t<Filter>>;
+
+template <typename Lhs, typename Rhs>
+class AndFilter : public DocumentFilter {
+public:
+    AndFilter(Lhs lhs, Rhs rhs)
+        : lhs_(std::move(lhs))
+        , rhs_(std::move(rhs)) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        char rhs_mask[FILTER_BLOCK_SIZE];
+        lhs_.EvaluateBlock(columns, rows, count, mask);
+        rhs_.EvaluateBlock(columns, rows, count, rhs_mask);
+        for (size_t i = 0; i < count; ++i) {
+            mask[i] &= rhs_mask[i];
+        }
+    }
+
+private:
+    Lhs lhs_;
+    Rhs rhs_;
+};
+
+template <typename Lhs, typename Rhs>
+class OrFilter : public DocumentFilter {
+public:
+    OrFilter(Lhs lhs, Rhs rhs)
+        : lhs_(std::move(lhs))
+        , rhs_(std::move(rhs)) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        char rhs_mask[FILTER_BLOCK_SIZE];
+        lhs_.EvaluateBlock(columns, rows, count, mask);
+        rhs_.EvaluateBlock(columns, rows, count, rhs_mask);
+        for (size_t i = 0; i < count; ++i) {
+            mask[i] |= rhs_mask[i];
+        }
+    }
+
+private:
+    Lhs lhs_;
+    Rhs rhs_;
+};
+
+template <typename Operand>
+class NotFilter : public DocumentFilter {
+public:
+    explicit NotFilter(Operand operand)
+        : operand_(std::move(operand)) {
+    }
+
+    void EvaluateBlock(const DocumentColumns& columns, const uint32_t* rows, size_t count, char* mask) const {
+        operand_.EvaluateBlock(columns, rows, count, mask);
+        for (size_t i = 0; i < count; ++i) {
+            mask[i] = !mask[i];
+        }
+    }
+
+private:
+    Operand operand_;
+};
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<IS_DOCUMENT_FILTER<Lhs> && IS_DOCUMENT_FILTER<Rhs>>>
+AndFilter<Lhs, Rhs> operator&&(Lhs lhs, Rhs rhs) {
+    return {std::move(lhs), std::move(rhs)};
+}
+
+template <typename Lhs, typename Rhs, typename = std::enable_if_t<IS_DOCUMENT_FILTER<Lhs> && IS_DOCUMENT_FILTER<Rhs>>>
+OrFilter<Lhs, Rhs> operator||(Lhs lhs, Rhs rhs) {
+    return {std::move(lhs), std::move(rhs)};
+}
+
+template <typename Operand, typename = std::enable_if_t<IS_DOCUMENT_FILTER<Operand>>>
+NotFilter<Operand> operator!(Operand operand) {
+    return NotFilter<Operand>(std::move(operand));
+}
+
+// Фильтр возвращается как есть, предикат оборачивается в PredicateFilter
+template <typename DocumentPredicate>
+auto MakeDocumentFilter(DocumentPredicate predicate) {
+    if constexpr (IS_DOCUMENT_FILTER<DocumentPredicate>) {
+        return predicate;
+    } else {
+        return PredicateFilter<DocumentPredicate>(std::move(predicate));
+    }
+}
@@ -0,0 +1,106 @@
+#include "document_text_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+DocumentTextStore::DocumentTextStore(const std::string& path, size_t block_size, size_t cache_block_count)
+    : path_(path)
+    , block_size_(std::max<size_t>(block_size, 1))
+    , cache_block_count_(std::max<size_t>(cache_block_count, 1)) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Не удалось открыть файл "s + path);
+    }
+}
+
+DocumentTextStore::~DocumentTextStore() {
+    close(fd_);
+}
+
+DocumentTextStore::Location DocumentTextStore::Append(std::string_view text) {
+    std::lock_guard lock(mutex_);
+    const Location location = {flushed_size_ + tail_.size(), text.size()};
+    tail_.append(text);
+
+    // Все заполненные блоки записываются одним вызовом
+    const size_t full_size = tail_.size() / block_size_ * block_size_;
+    size_t written = 0;
+    while (written < full_size) {
+        const ssize_t result = pwrite(fd_, tail_.data() + written, full_size - written, flushed_size_ + written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Не удалось записать в файл "s + path_);
+        }
+        written += static_cast<size_t>(result);
+    }
+    tail_.erase(0, full_size);
+    flushed_size_ += full_size;
+    return location;
+}
+
+std::string DocumentTextStore::Read(Location location) const {
+    std::lock_guard lock(mutex_);
+    if (location.offset + location.size > flushed_size_ + tail_.size()) {
+        throw std::out_of_range("Текст выходит за пределы хранилища "s + path_);
+    }
+
+    std::string text;
+    text.reserve(location.size);
+    uint64_t position = location.offset;
+    const uint64_t end = location.offset + location.size;
+    while (position < end) {
+        if (position >= flushed_size_) {
+            text.append(tail_, position - flushed_size_, end - position);
+            break;
+        }
+        const uint64_t block_index = position / block_size_;
+        const uint64_t block_begin = block_index * block_size_;
+        const std::string& block = GetBlock(block_index);
+        const uint64_t part_size = std::min(end, block_begin + block_size_) - position;
+        text.append(block, position - block_begin, part_size);
+        position += part_size;
+    }
+    return text;
+}
+
+size_t DocumentTextStore::GetMemoryUsage() const {
+    std::lock_guard lock(mutex_);
+    return tail_.capacity() + cached_blocks_.size() * (block_size_ + sizeof(CachedBlock) + sizeof(void*) * 4);
+}
+
+const std::string& DocumentTextStore::GetBlock(uint64_t block_index) const {
+    const auto found = cache_index_.find(block_index);
+    if (found != cache_index_.end()) {
+        cached_blocks_.splice(cached_blocks_.begin(), cached_blocks_, found->second);
+        return found->second->second;
+    }
+
+    std::string block(block_size_, '\0');
+    size_t read = 0;
+    while (read < block_size_) {
+        const ssize_t result = pread(fd_, block.data() + read, block_size_ - read, block_index * block_size_ + read);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            throw std::runtime_error("Не удалось прочитать файл "s + path_);
+        }
+        read += static_cast<size_t>(result);
+    }
+
+    if (cached_blocks_.size() == cache_block_count_) {
+        cache_index_.erase(cached_blocks_.back().first);
+        cached_blocks_.pop_back();
+    }
+    cached_blocks_.emplace_front(block_index, std::move(block));
+    cache_index_[block_index] = cached_blocks_.begin();
+    return cached_blocks_.front().second;
+}
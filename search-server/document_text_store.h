@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Файловое хранилище текстов документов.
+// Тексты дописываются в конец файла подряд; файл читается блоками фиксированного размера,
+// и в памяти остаются только неполный последний блок и кэш недавно прочитанных блоков (LRU).
+// Методы можно вызывать из разных потоков одновременно
+class DocumentTextStore {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    static constexpr size_t DEFAULT_CACHE_BLOCK_COUNT = 64;
+
+    // Положение текста в хранилище
+    struct Location {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    // Файл создаётся заново; существующий файл перезаписывается
+    explicit DocumentTextStore(const std::string& path,
+                               size_t block_size = DEFAULT_BLOCK_SIZE,
+                               size_t cache_block_count = DEFAULT_CACHE_BLOCK_COUNT);
+
+    DocumentTextStore(const DocumentTextStore&) = delete;
+    DocumentTextStore& operator=(const DocumentTextStore&) = delete;
+
+    // Закрывает файл, не удаляя его
+    ~DocumentTextStore();
+
+    Location Append(std::string_view text);
+
+    std::string Read(Location location) const;
+
+    // Память, занятая неполным блоком и кэшем, в байтах
+    size_t GetMemoryUsage() const;
+
+private:
+    using CachedBlock = std::pair<uint64_t, std::string>;
+
+    const std::string path_;
+    const size_t block_size_;
+    const size_t cache_block_count_;
+    int fd_ = -1;
+
+    mutable std::mutex mutex_;
+    // Размер данных, уже записанных в файл; всегда кратен block_size_
+    uint64_t flushed_size_ = 0;
+    // Неполный последний блок, ещё не записанный в файл
+    std::string tail_;
+    // Номер блока -> его содержимое; в начале списка — последние использованные
+    mutable std::list<CachedBlock> cached_blocks_;
+    mutable std::unordered_map<uint64_t, std::list<CachedBlock>::iterator> cache_index_;
+
+    // Требует блокировки mutex_. Ссылка действительна до следующего вызова
+    const std::string& GetBlock(uint64_t block_index) const;
+};
@@ -0,0 +1,354 @@
+#include "index_log.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// Заголовок записи: размер полезной нагрузки, CRC32 нагрузки и номера, номер
+constexpr size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+std::array<uint32_t, 256> MakeCrc32Table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+// CRC32 (IEEE). Сумму можно продолжать: UpdateCrc32(UpdateCrc32(0, a), b) — сумма a и b подряд
+uint32_t UpdateCrc32(uint32_t crc, std::string_view data) {
+    static const std::array<uint32_t, 256> table = MakeCrc32Table();
+    crc = ~crc;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t ComputeRecordCrc32(std::string_view payload, uint64_t sequence) {
+    return UpdateCrc32(UpdateCrc32(0, payload), {reinterpret_cast<const char*>(&sequence), sizeof(sequence)});
+}
+
+template <typename T>
+void WriteValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void WriteBytes(std::string& out, std::string_view bytes) {
+    WriteValue(out, static_cast<uint32_t>(bytes.size()));
+    out.append(bytes);
+}
+
+// Чтение полезной нагрузки записи с проверкой границ
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view payload)
+        : payload_(payload) {
+    }
+
+    template <typename T>
+    T ReadValue() {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view ReadBytes() {
+        return Take(ReadValue<uint32_t>());
+    }
+
+    bool IsEmpty() const {
+        return payload_.empty();
+    }
+
+private:
+    std::string_view payload_;
+
+    std::string_view Take(size_t size) {
+        if (size > payload_.size()) {
+            throw std::invalid_argument("Некорректная запись журнала индекса"s);
+        }
+        const std::string_view result = payload_.substr(0, size);
+        payload_.remove_prefix(size);
+        return result;
+    }
+};
+
+IndexLogEntry DecodeEntry(uint64_t sequence, std::string_view payload) {
+    PayloadReader reader(payload);
+    IndexLogEntry entry;
+    entry.sequence = sequence;
+    entry.operation = static_cast<IndexLogOperation>(reader.ReadValue<uint8_t>());
+    entry.document_id = reader.ReadValue<int32_t>();
+    switch (entry.operation) {
+        case IndexLogOperation::ADD_DOCUMENT: {
+            const uint8_t status = reader.ReadValue<uint8_t>();
+            if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+                throw std::invalid_argument("Неизвестный статус документа в журнале индекса"s);
+            }
+            entry.status = static_cast<DocumentStatus>(status);
+            entry.ratings.resize(reader.ReadValue<uint32_t>());
+            for (int& rating : entry.ratings) {
+                rating = reader.ReadValue<int32_t>();
+            }
+            entry.text = reader.ReadBytes();
+            break;
+        }
+        case IndexLogOperation::REMOVE_DOCUMENT:
+            break;
+        case IndexLogOperation::SET_DOCUMENT_ATTRIBUTE:
+            entry.attribute_name = reader.ReadBytes();
+            entry.attribute_value = reader.ReadValue<int64_t>();
+            break;
+        default:
+            throw std::invalid_argument("Неизвестная операция в журнале индекса"s);
+    }
+    if (!reader.IsEmpty()) {
+        throw std::invalid_argument("Некорректная запись журнала индекса"s);
+    }
+    return entry;
+}
+
+// Вызывает func(sequence, payload) для каждой целой записи подряд и возвращает их общую длину.
+// Обход прекращается на записи, которая не умещается в data, не сходится с контрольной суммой
+// или нарушает порядок номеров
+template <typename Func>
+size_t ForEachRecord(std::string_view data, Func func) {
+    size_t valid_size = 0;
+    uint64_t previous_sequence = 0;
+    while (data.size() - valid_size >= RECORD_HEADER_SIZE) {
+        const char* header = data.data() + valid_size;
+        uint32_t payload_size;
+        uint32_t crc;
+        uint64_t sequence;
+        std::memcpy(&payload_size, header, sizeof(payload_size));
+        std::memcpy(&crc, header + sizeof(payload_size), sizeof(crc));
+        std::memcpy(&sequence, header + sizeof(payload_size) + sizeof(crc), sizeof(sequence));
+        if (payload_size > data.size() - valid_size - RECORD_HEADER_SIZE) {
+            break;
+        }
+        const std::string_view payload = data.substr(valid_size + RECORD_HEADER_SIZE, payload_size);
+        if (ComputeRecordCrc32(payload, sequence) != crc
+            || (previous_sequence != 0 && sequence != previous_sequence + 1)) {
+            break;
+        }
+        func(sequence, payload);
+        previous_sequence = sequence;
+        valid_size += RECORD_HEADER_SIZE + payload_size;
+    }
+    return valid_size;
+}
+
+bool WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t result = write(fd, data.data(), data.size());
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(result));
+    }
+    return true;
+}
+
+} // namespace
+
+std::vector<IndexLogEntry> ParseIndexLog(std::string_view data, uint64_t after_sequence, size_t* valid_size) {
+    std::vector<IndexLogEntry> entries;
+    const size_t size = ForEachRecord(data, [after_sequence, &entries](uint64_t sequence, std::string_view payload) {
+        if (sequence > after_sequence) {
+            entries.push_back(DecodeEntry(sequence, payload));
+        }
+    });
+    if (valid_size != nullptr) {
+        *valid_size = size;
+    }
+    return entries;
+}
+
+IndexLog::IndexLog(const std::string& path, std::chrono::microseconds commit_interval, size_t max_pending_bytes)
+    : path_(path)
+    , commit_interval_(commit_interval)
+    , max_pending_bytes_(std::max<size_t>(max_pending_bytes, 1)) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Не удалось открыть файл "s + path);
+    }
+
+    // Номера записей продолжают уже записанные. Файл просматривается через отображение в память,
+    // чтобы не копировать весь журнал в кучу; отображение освобождается после просмотра
+    size_t file_size = 0;
+    size_t valid_size = 0;
+    try {
+        const MappedFile mapped_file(path);
+        const std::string_view data = mapped_file.GetData();
+        file_size = data.size();
+        valid_size = ForEachRecord(data, [this](uint64_t sequence, std::string_view) {
+            last_sequence_ = sequence;
+        });
+    } catch (...) {
+        close(fd_);
+        throw;
+    }
+    durable_sequence_ = last_sequence_;
+
+    // Недописанный хвост отбрасывается, чтобы новые записи шли сразу за целыми
+    if ((valid_size < file_size && ftruncate(fd_, static_cast<off_t>(valid_size)) != 0)
+        || lseek(fd_, static_cast<off_t>(valid_size), SEEK_SET) < 0) {
+        close(fd_);
+        throw std::runtime_error("Не удалось восстановить файл "s + path);
+    }
+
+    writer_ = std::thread([this] { WriterLoop(); });
+}
+
+IndexLog::~IndexLog() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    writer_cv_.notify_one();
+    writer_.join();
+    close(fd_);
+}
+
+uint64_t IndexLog::AppendAddDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings, std::string_view text) {
+    std::string payload;
+    payload.reserve(16 + ratings.size() * sizeof(int32_t) + text.size());
+    WriteValue(payload, static_cast<uint8_t>(IndexLogOperation::ADD_DOCUMENT));
+    WriteValue(payload, static_cast<int32_t>(document_id));
+    WriteValue(payload, static_cast<uint8_t>(status));
+    WriteValue(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        WriteValue(payload, static_cast<int32_t>(rating));
+    }
+    WriteBytes(payload, text);
+    return Append(payload);
+}
+
+uint64_t IndexLog::AppendRemoveDocument(int document_id) {
+    std::string payload;
+    WriteValue(payload, static_cast<uint8_t>(IndexLogOperation::REMOVE_DOCUMENT));
+    WriteValue(payload, static_cast<int32_t>(document_id));
+    return Append(payload);
+}
+
+uint64_t IndexLog::AppendSetDocumentAttribute(int document_id, std::string_view name, int64_t value) {
+    std::string payload;
+    WriteValue(payload, static_cast<uint8_t>(IndexLogOperation::SET_DOCUMENT_ATTRIBUTE));
+    WriteValue(payload, static_cast<int32_t>(document_id));
+    WriteBytes(payload, name);
+    WriteValue(payload, value);
+    return Append(payload);
+}
+
+void IndexLog::WaitDurable(uint64_t sequence) {
+    std::unique_lock lock(mutex_);
+    ++durable_waiter_count_;
+    writer_cv_.notify_one();
+    durable_cv_.wait(lock, [this, sequence] { return durable_sequence_ >= sequence || write_failed_; });
+    --durable_waiter_count_;
+    if (durable_sequence_ < sequence) {
+        CheckNotFailed();
+    }
+}
+
+void IndexLog::CheckWritable() const {
+    std::lock_guard lock(mutex_);
+    CheckNotFailed();
+}
+
+void IndexLog::Flush() {
+    WaitDurable(GetLastSequence());
+}
+
+uint64_t IndexLog::GetLastSequence() const {
+    std::lock_guard lock(mutex_);
+    return last_sequence_;
+}
+
+uint64_t IndexLog::GetDurableSequence() const {
+    std::lock_guard lock(mutex_);
+    return durable_sequence_;
+}
+
+uint64_t IndexLog::Append(std::string_view payload) {
+    // Контрольная сумма нагрузки считается вне блокировки, номер досчитывается под ней
+    const uint32_t payload_crc = UpdateCrc32(0, payload);
+
+    std::unique_lock lock(mutex_);
+    durable_cv_.wait(lock, [this] { return pending_.size() < max_pending_bytes_ || write_failed_; });
+
+    const uint64_t sequence = ++last_sequence_;
+    if (write_failed_) {
+        // Запись уже не попадёт в файл; WaitDurable(sequence) сообщит о сбое
+        return sequence;
+    }
+    const bool was_empty = pending_.empty();
+    WriteValue(pending_, static_cast<uint32_t>(payload.size()));
+    WriteValue(pending_, UpdateCrc32(payload_crc, {reinterpret_cast<const char*>(&sequence), sizeof(sequence)}));
+    WriteValue(pending_, sequence);
+    pending_.append(payload);
+    if (was_empty || pending_.size() >= max_pending_bytes_) {
+        writer_cv_.notify_one();
+    }
+    return sequence;
+}
+
+void IndexLog::WriterLoop() {
+    std::string batch;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        writer_cv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            break;
+        }
+        // Пачка копится, пока никто не ждёт её записи и буфер не переполнен
+        writer_cv_.wait_for(lock, commit_interval_, [this] {
+            return stopping_ || durable_waiter_count_ > 0 || pending_.size() >= max_pending_bytes_;
+        });
+
+        batch.swap(pending_);
+        const uint64_t batch_sequence = last_sequence_;
+        // Буфер освободился — можно продолжать Append*
+        durable_cv_.notify_all();
+
+        // Запись и fdatasync идут без блокировки, чтобы не задерживать Append*
+        lock.unlock();
+        const bool is_written = WriteAll(fd_, batch) && fdatasync(fd_) == 0;
+        batch.clear();
+        lock.lock();
+
+        if (!is_written) {
+            write_failed_ = true;
+            pending_.clear();
+            durable_cv_.notify_all();
+            break;
+        }
+        durable_sequence_ = batch_sequence;
+        durable_cv_.notify_all();
+    }
+}
+
+void IndexLog::CheckNotFailed() const {
+    if (write_failed_) {
+        throw std::runtime_error("Не удалось записать журнал индекса "s + path_);
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+
+// Изменения индекса, которые записываются в журнал
+enum class IndexLogOperation : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    SET_DOCUMENT_ATTRIBUTE = 3,
+};
+
+// Запись журнала. Строковые поля ссылаются прямо на разобранные данные
+struct IndexLogEntry {
+    // Номера записей идут подряд, начиная с 1
+    uint64_t sequence = 0;
+    IndexLogOperation operation = IndexLogOperation::ADD_DOCUMENT;
+    int document_id = 0;
+    // ADD_DOCUMENT
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+    // SET_DOCUMENT_ATTRIBUTE
+    std::string_view attribute_name;
+    int64_t attribute_value = 0;
+};
+
+// Разбор журнала. Возвращает записи с номерами больше after_sequence.
+// Разбор останавливается на первой неполной или повреждённой записи (например, недописанной
+// при аварийном завершении); если valid_size не nullptr, туда записывается длина целых записей
+std::vector<IndexLogEntry> ParseIndexLog(std::string_view data, uint64_t after_sequence = 0, size_t* valid_size = nullptr);
+
+// Журнал изменений индекса, открытый на дозапись.
+// Каждая запись снабжена номером и контрольной суммой CRC32.
+// Append* только копируют запись в буфер; буфер записывается в файл фоновым потоком,
+// который копит записи до commit_interval и завершает всю пачку одним fdatasync (групповая фиксация).
+// Методы можно вызывать из разных потоков одновременно
+class IndexLog {
+public:
+    static constexpr std::chrono::microseconds DEFAULT_COMMIT_INTERVAL{2000};
+    static constexpr size_t DEFAULT_MAX_PENDING_BYTES = 16 * 1024 * 1024;
+
+    // Существующий файл дописывается: недописанный хвост отбрасывается, номера записей продолжаются.
+    // Если в буфере набралось max_pending_bytes, Append* ждут, пока фоновый поток его запишет
+    explicit IndexLog(const std::string& path,
+                      std::chrono::microseconds commit_interval = DEFAULT_COMMIT_INTERVAL,
+                      size_t max_pending_bytes = DEFAULT_MAX_PENDING_BYTES);
+
+    IndexLog(const IndexLog&) = delete;
+    IndexLog& operator=(const IndexLog&) = delete;
+
+    // Записывает буфер и закрывает файл
+    ~IndexLog();
+
+    // Возвращают номер добавленной записи. Исключений из-за сбоя записи в файл не бросают:
+    // после сбоя записи отбрасываются, а сбой сообщают CheckWritable, WaitDurable и Flush
+    uint64_t AppendAddDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings, std::string_view text);
+    uint64_t AppendRemoveDocument(int document_id);
+    uint64_t AppendSetDocumentAttribute(int document_id, std::string_view name, int64_t value);
+
+    // Бросает std::runtime_error, если фоновый поток не смог записать журнал.
+    // Вызывается перед изменением индекса, чтобы изменение не прошло мимо журнала
+    void CheckWritable() const;
+
+    // Ждёт, пока запись с номером sequence и все предыдущие окажутся на диске
+    void WaitDurable(uint64_t sequence);
+    // Ждёт записи на диск всех добавленных записей
+    void Flush();
+
+    uint64_t GetLastSequence() const;
+    uint64_t GetDurableSequence() const;
+
+private:
+    const std::string path_;
+    const std::chrono::microseconds commit_interval_;
+    const size_t max_pending_bytes_;
+    int fd_ = -1;
+
+    mutable std::mutex mutex_;
+    // Будит фоновый поток
+    std::condition_variable writer_cv_;
+    // Будит ждущих записи на диск и освобождения буфера
+    std::condition_variable durable_cv_;
+    // Записи, ещё не переданные в файл
+    std::string pending_;
+    uint64_t last_sequence_ = 0;
+    uint64_t durable_sequence_ = 0;
+    // Сколько потоков ждут в WaitDurable: при них пачка не копится до commit_interval
+    size_t durable_waiter_count_ = 0;
+    bool write_failed_ = false;
+    bool stopping_ = false;
+
+    std::thread writer_;
+
+    // Добавляет запись с полезной нагрузкой payload и возвращает её номер
+    uint64_t Append(std::string_view payload);
+
+    void WriterLoop();
+
+    // Требует блокировки mutex_
+    void CheckNotFailed() const;
+};
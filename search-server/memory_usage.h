@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Оценка памяти, занимаемой структурами сервера, в байтах
+struct MemoryUsage {
+    size_t stop_words = 0;
+    // Данные документов и собственные копии их текстов
+    size_t documents = 0;
+    // Словарь слов, на который ссылаются индексы
+    size_t words = 0;
+    // Слово -> документы (word_to_document_freqs_)
+    size_t inverted_index = 0;
+    // Документ -> слова (word_to_document_freqs_ids_)
+    size_t forward_index = 0;
+    size_t document_ids = 0;
+    // Буфер и кэш блоков файлового хранилища текстов
+    size_t text_store = 0;
+
+    size_t GetTotal() const {
+        return stop_words + documents + words + inverted_index + forward_index + document_ids + text_store;
+    }
+};
+
+// Служебные данные узла std::map/std::set: цвет и три указателя
+constexpr size_t TREE_NODE_OVERHEAD = sizeof(void*) * 4;
+
+// Память узлов std::map/std::set без учёта того, на что ссылаются их элементы
+template <typename Tree>
+size_t EstimateTreeNodesBytes(const Tree& tree) {
+    return tree.size() * (TREE_NODE_OVERHEAD + sizeof(typename Tree::value_type));
+}
+
+// Память в куче, занятая строкой сверх самого объекта std::string
+inline size_t EstimateStringHeapBytes(const std::string& str) {
+    static const size_t inline_capacity = std::string().capacity();
+    return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+}
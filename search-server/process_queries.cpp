@@ -1,5 +1,6 @@
 #include "process_queries.h"
 
+#include <cstdint>
 #include <execution>
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries) {
@@ -11,10 +12,27 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
 }
 
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries) {
-    return std::transform_reduce(std::execution::par, queries.begin(), queries.end(), std::vector<Document>{}, [] (std::vector<Document> destination, const std::vector<Document>& departure) {
-        destination.insert(destination.end(), departure.begin(), departure.end()); 
-        return destination; 
-    }, [&search_server] (const std::string& query) {
-        return search_server.FindTopDocuments(query); 
+    // Склейка не коммутативна, поэтому transform_reduce мог перемешать результаты запросов
+    std::vector<Document> result;
+    for (const std::vector<Document>& documents : ProcessQueries(search_server, queries)) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+    return result;
+}
+
+std::vector<std::vector<Document>> ProcessQueries(ThreadPool& thread_pool, const SearchServer& search_server, const std::vector<std::string>& queries) {
+    std::vector<std::vector<Document>> buff(queries.size());
+    // Каждый запрос — заведомо крупная задача, поэтому объём работы не даёт выполнить их в одном потоке
+    thread_pool.ParallelFor(queries.size(), SIZE_MAX, [&buff, &search_server, &queries] (size_t i) {
+        buff[i] = search_server.FindTopDocuments(queries[i]);
     });
+    return buff;
+}
+
+std::vector<Document> ProcessQueriesJoined(ThreadPool& thread_pool, const SearchServer& search_server, const std::vector<std::string>& queries) {
+    std::vector<Document> result;
+    for (const std::vector<Document>& documents : ProcessQueries(thread_pool, search_server, queries)) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }
+    return result;
 }
\ No newline at end of file
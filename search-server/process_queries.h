@@ -6,4 +6,9 @@
 
 std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries);
 
-std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
+std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+// Версии, выполняющие запросы в пуле потоков движка
+std::vector<std::vector<Document>> ProcessQueries(ThreadPool& thread_pool, const SearchServer& search_server, const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesJoined(ThreadPool& thread_pool, const SearchServer& search_server, const std::vector<std::string>& queries);
\ No newline at end of file
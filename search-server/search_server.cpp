@@ -3,6 +3,7 @@
 #include <cmath>
 #include <algorithm>
 #include <numeric>
+#include <queue>
 
 using namespace std::string_literals;
 
@@ -15,23 +16,139 @@ SearchServer::SearchServer(std::string stop_words_text)
  } 
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    CheckNewDocumentId(document_id);
+    CheckIndexLogWritable();
+    // Всё, что может выбросить исключение, выполняется до изменения сервера
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document, stop_words_);
+    DocumentData document_data = MakeDocumentData(document);
+    
+    document_data.row = columns_.Append(document_id, status, ComputeAverageRating(ratings));
+    auto [document_id_emplaced, document_data_emplaced] = documents_.emplace(document_id, std::move(document_data));
+    // Переданный текст живёт только до конца вызова, поэтому в памяти хранится его копия
+    if (text_storage_mode_ == TextStorageMode::IN_MEMORY) {
+        document_id_emplaced->second.string_data = std::string(document);
+        document_id_emplaced->second.text = document_id_emplaced->second.string_data;
+    }
+    
+    document_ids_.push_back(document_id);
+
+    IndexDocument(document_id, words);
+    ++index_version_;
+
+    if (index_log_) {
+        index_log_->AppendAddDocument(document_id, status, ratings, document);
+    }
+}
+
+void SearchServer::AddDocuments(std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records) {
+    // Тексты разбираются заранее, чтобы недопустимый текст не оставил пачку добавленной наполовину
+    std::vector<std::vector<std::string_view>> document_words;
+    document_words.reserve(records.size());
+    for (const DocumentRecord& record : records) {
+        document_words.push_back(SplitIntoWordsNoStop(record.text, stop_words_));
+    }
+    AddDocumentsSplit(std::move(text_storage), records, document_words);
+}
+
+void SearchServer::AddDocuments(ThreadPool& thread_pool, std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records) {
+    // Разбор текста не меняет сервер, поэтому тексты разбираются одновременно
+    std::vector<std::vector<std::string_view>> document_words(records.size());
+    size_t text_size = 0;
+    for (const DocumentRecord& record : records) {
+        text_size += record.text.size();
+    }
+    thread_pool.ParallelFor(records.size(), text_size, [this, &records, &document_words](size_t i) {
+        document_words[i] = SplitIntoWordsNoStop(records[i].text, stop_words_);
+    });
+    AddDocumentsSplit(std::move(text_storage), records, document_words);
+}
+
+void SearchServer::AddDocumentsSplit(std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records,
+                                     const std::vector<std::vector<std::string_view>>& document_words) {
+    // Всё, что может выбросить исключение, выполняется до изменения сервера
+    std::vector<int> new_document_ids;
+    new_document_ids.reserve(records.size());
+    for (const DocumentRecord& record : records) {
+        CheckNewDocumentId(record.id);
+        new_document_ids.push_back(record.id);
+    }
+    std::sort(new_document_ids.begin(), new_document_ids.end());
+    if (std::adjacent_find(new_document_ids.begin(), new_document_ids.end()) != new_document_ids.end()) {
+        throw std::invalid_argument("ID документа повторяется в пачке"s);
+    }
+    CheckIndexLogWritable();
+    std::vector<DocumentData> document_datas;
+    document_datas.reserve(records.size());
+    for (const DocumentRecord& record : records) {
+        document_datas.push_back(MakeDocumentData(record.text));
+    }
+
+    // Одно хранилище может приходить несколькими пачками (например, при воспроизведении журнала)
+    if (text_storage_mode_ == TextStorageMode::IN_MEMORY
+        && std::find(text_storages_.begin(), text_storages_.end(), text_storage) == text_storages_.end()) {
+        text_storages_.push_back(std::move(text_storage));
+    }
+    ++index_version_;
+    document_ids_.reserve(document_ids_.size() + records.size());
+    
+    for (size_t i = 0; i < records.size(); ++i) {
+        const DocumentRecord& record = records[i];
+        DocumentData& document_data = document_datas[i];
+        document_data.row = columns_.Append(record.id, record.status, ComputeAverageRating(record.ratings));
+        documents_.emplace(record.id, std::move(document_data));
+        document_ids_.push_back(record.id);
+        IndexDocument(record.id, document_words[i]);
+        if (index_log_) {
+            index_log_->AppendAddDocument(record.id, record.status, record.ratings, record.text);
+        }
+    }
+}
+
+SearchServer::DocumentData SearchServer::MakeDocumentData(std::string_view text) {
+    DocumentData document_data{0, {}, {}, {}};
+    switch (text_storage_mode_) {
+        case TextStorageMode::IN_MEMORY:
+            document_data.text = text;
+            break;
+        case TextStorageMode::EXTERNAL_FILE:
+            document_data.text_location = text_store_->Append(text);
+            break;
+        case TextStorageMode::DISCARD:
+            break;
+    }
+    return document_data;
+}
+
+void SearchServer::CheckNewDocumentId(int document_id) const {
     if (document_id < 0) {
         throw std::invalid_argument("ID документа не должен быть отрицательным"s);
     }
     if (documents_.count(document_id)) {
         throw std::invalid_argument("Такой ID документа уже существует"s);
     }
-    
-    auto [document_id_emplaced, document_data_emplaced] = documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, std::string(document)});
-    
-    document_ids_.push_back(document_id);
+}
+
+void SearchServer::CheckIndexLogWritable() const {
+    if (index_log_) {
+        index_log_->CheckWritable();
+    }
+}
 
-    const auto words = SplitIntoWordsNoStop(document_id_emplaced->second.string_data);
+void SearchServer::IndexDocument(int document_id, const std::vector<std::string_view>& words) {
     const double inv_word_count = 1.0 / words.size();
+    const uint32_t row = documents_.at(document_id).row;
     
     for (std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        word_to_document_freqs_ids_[document_id][word] += inv_word_count;
+        auto found_word = words_.find(word);
+        if (found_word == words_.end()) {
+            found_word = words_.emplace(word).first;
+        }
+        // Ключи индексов ссылаются на словарь, поэтому не зависят от времени жизни текста
+        const std::string_view owned_word = *found_word;
+        DocumentPosting& posting = word_to_document_freqs_[owned_word][document_id];
+        posting.term_freq += inv_word_count;
+        posting.row = row;
+        word_to_document_freqs_ids_[document_id][owned_word] += inv_word_count;
     }
 }
 
@@ -43,67 +160,254 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
     return FindTopDocuments(std::execution::seq, raw_query);
 }
 
+PreparedQuery SearchServer::PrepareQuery(std::string_view raw_query, QueryMode mode) const {
+    const Query query = ParseQuery<Query>(raw_query, stop_words_);
+    PreparedQuery prepared_query;
+    prepared_query.search_server_ = this;
+    prepared_query.index_version_ = index_version_;
+    prepared_query.mode_ = mode;
+
+    // Слова, которых нет в индексе, не попадают в запрос. Возвращает, нашлось ли слово
+    const auto resolve = [this, &prepared_query](std::string_view word, auto& terms) {
+        if (word.back() == '*') {
+            const PreparedQuery::Term term = ResolvePrefix(word.substr(0, word.size() - 1), prepared_query);
+            if (term.document_freqs->empty()) {
+                return false;
+            }
+            terms.push_back(term);
+            return true;
+        }
+        const auto found = word_to_document_freqs_.find(word);
+        if (found == word_to_document_freqs_.end() || found->second.empty()) {
+            return false;
+        }
+        terms.push_back({&found->second, ComputeWordInverseDocumentFreq(word), found, std::next(found), false});
+        return true;
+    };
+    for (std::string_view word : query.plus_words) {
+        if (!resolve(word, prepared_query.plus_terms_)) {
+            prepared_query.has_missing_plus_word_ = true;
+        }
+    }
+    for (std::string_view word : query.minus_words) {
+        resolve(word, prepared_query.minus_terms_);
+    }
+    return prepared_query;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status) const {
+    return FindTopDocuments(std::execution::seq, query, status);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+    return FindTopDocuments(std::execution::seq, query);
+}
+
+DeadlineSearchResult SearchServer::FindTopDocumentsWithDeadline(std::string_view raw_query, DocumentStatus status, SearchClock::time_point deadline,
+                                                               QueryMode mode) const {
+    return FindTopDocumentsWithDeadline(raw_query, StatusEquals(status), deadline, mode);
+}
+
 int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+void SearchServer::SetTextStorage(TextStorageMode mode, std::shared_ptr<DocumentTextStore> text_store) {
+    if (!documents_.empty()) {
+        throw std::logic_error("Место хранения текстов можно менять только у пустого сервера"s);
+    }
+    if (mode == TextStorageMode::EXTERNAL_FILE && text_store == nullptr) {
+        throw std::invalid_argument("Для хранения текстов в файле не передано хранилище"s);
+    }
+    text_storage_mode_ = mode;
+    text_store_ = mode == TextStorageMode::EXTERNAL_FILE ? std::move(text_store) : nullptr;
+    text_storages_.clear();
+}
+
+std::string SearchServer::GetDocumentText(int document_id) const {
+    const auto found_document = documents_.find(document_id);
+    if (found_document == documents_.end()) {
+        throw std::invalid_argument("Несуществующий ID документа"s);
+    }
+    switch (text_storage_mode_) {
+        case TextStorageMode::IN_MEMORY:
+            return std::string(found_document->second.text);
+        case TextStorageMode::EXTERNAL_FILE:
+            return text_store_->Read(found_document->second.text_location);
+        case TextStorageMode::DISCARD:
+            break;
+    }
+    throw std::logic_error("Тексты документов не сохраняются"s);
+}
+
+void SearchServer::SetIndexLog(std::shared_ptr<IndexLog> index_log) {
+    index_log_ = std::move(index_log);
+}
+
+void SearchServer::SetDocumentAttribute(int document_id, std::string_view name, int64_t value) {
+    const auto found_document = documents_.find(document_id);
+    if (found_document == documents_.end()) {
+        throw std::invalid_argument("Несуществующий ID документа"s);
+    }
+    CheckIndexLogWritable();
+    auto values = columns_.attributes.find(name);
+    if (values == columns_.attributes.end()) {
+        values = columns_.attributes.emplace(std::string(name), std::vector<int64_t>(columns_.GetRowCount(), 0)).first;
+    }
+    values->second[found_document->second.row] = value;
+
+    if (index_log_) {
+        index_log_->AppendSetDocumentAttribute(document_id, name, value);
+    }
+}
+
+int64_t SearchServer::GetDocumentAttribute(int document_id, std::string_view name) const {
+    const auto found_document = documents_.find(document_id);
+    if (found_document == documents_.end()) {
+        throw std::invalid_argument("Несуществующий ID документа"s);
+    }
+    const auto values = columns_.attributes.find(name);
+    return values == columns_.attributes.end() ? 0 : values->second[found_document->second.row];
+}
+
 MatchTuple SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
 MatchTuple SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::seq, PrepareQuery(raw_query), document_id);
+}
+
+MatchTuple SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
+    return MatchDocument(std::execution::par, PrepareQuery(raw_query), document_id);
+}
+
+MatchTuple SearchServer::MatchDocument(ThreadPool& thread_pool, std::string_view raw_query, int document_id) const {
+    return MatchDocument(thread_pool, PrepareQuery(raw_query), document_id);
+}
+
+MatchTuple SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+    return MatchDocument(std::execution::seq, query, document_id);
+}
+
+MatchTuple SearchServer::MatchDocument(const std::execution::sequenced_policy&, const PreparedQuery& query, int document_id) const {
     if ((document_id < 0) || (documents_.count(document_id) == 0)) {
         throw std::invalid_argument("Несуществующий ID документа"s);
     }
+    CheckPreparedQuery(query);
     
-    const Query query = ParseQuery(raw_query);
+    const DocumentStatus status = columns_.statuses[documents_.at(document_id).row];
     std::vector<std::string_view> matched_words;
   
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return {{}, documents_.at(document_id).status};
+    for (const PreparedQuery::Term& term : query.minus_terms_) {
+        if (term.document_freqs->count(document_id)) {
+            return MatchTuple{matched_words, status};
         }
     }
+    if (MissesPlusTerm(query, document_id)) {
+        return MatchTuple{matched_words, status};
+    }
     
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    std::vector<const PreparedQuery::Term*> matched_terms;
+    for (const PreparedQuery::Term& term : query.plus_terms_) {
+        if (term.document_freqs->count(document_id)) {
+            matched_terms.push_back(&term);
         }
     }
     
-    return std::tuple<std::vector<std::string_view>, DocumentStatus>{matched_words, documents_.at(document_id).status};
-
+    return MatchTuple{CollectMatchedWords(matched_terms, document_id), status};
 }
 
-MatchTuple SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const {
-    const Query query = ParseQuery(raw_query);
-    std::vector<std::string_view> matched_words(query.plus_words.size());
+MatchTuple SearchServer::MatchDocument(const std::execution::parallel_policy&, const PreparedQuery& query, int document_id) const {
+    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+        throw std::invalid_argument("Несуществующий ID документа"s);
+    }
+    CheckPreparedQuery(query);
+
+    const DocumentStatus status = columns_.statuses[documents_.at(document_id).row];
+    std::vector<std::string_view> matched_words;
     
-    const auto check_if_word_exists = [this, document_id] (std::string_view word) {
-        const auto tmp = word_to_document_freqs_.find(word);
-        return tmp != word_to_document_freqs_.end() && tmp->second.count(document_id);
+    const auto check_if_word_exists = [document_id] (const PreparedQuery::Term& term) {
+        return term.document_freqs->count(document_id) > 0;
     };
  
     if (std::any_of(std::execution::par, 
-                    query.minus_words.begin(), 
-                    query.minus_words.end(), 
+                    query.minus_terms_.begin(), 
+                    query.minus_terms_.end(), 
                     check_if_word_exists)) {
-                        return {{}, documents_.at(document_id).status};
+                        return MatchTuple{matched_words, status};
+    }
+    if (MissesPlusTerm(query, document_id)) {
+        return MatchTuple{matched_words, status};
     }
     
-    auto copy_end = std::copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(),  matched_words.begin(), check_if_word_exists);
-    
-    std::sort(matched_words.begin(), copy_end);
-    copy_end = std::unique(matched_words.begin(), copy_end);
-    matched_words.erase(copy_end, matched_words.end());
+    std::vector<char> is_matched(query.plus_terms_.size());
+    std::transform(std::execution::par, query.plus_terms_.begin(), query.plus_terms_.end(), is_matched.begin(), check_if_word_exists);
+
+    std::vector<const PreparedQuery::Term*> matched_terms;
+    for (size_t i = 0; i < is_matched.size(); ++i) {
+        if (is_matched[i]) {
+            matched_terms.push_back(&query.plus_terms_[i]);
+        }
+    }
     
-    return std::tuple<std::vector<std::string_view>, DocumentStatus>{matched_words, documents_.at(document_id).status};
+    return MatchTuple{CollectMatchedWords(matched_terms, document_id), status};
+}
+
+MatchTuple SearchServer::MatchDocument(ThreadPool& thread_pool, const PreparedQuery& query, int document_id) const {
+    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+        throw std::invalid_argument("Несуществующий ID документа"s);
+    }
+    CheckPreparedQuery(query);
+
+    const DocumentStatus status = columns_.statuses[documents_.at(document_id).row];
+    std::vector<std::string_view> matched_words;
+
+    // Проверка слова — один поиск в дереве, поэтому объём работы равен числу слов
+    std::atomic<bool> has_minus_word = false;
+    thread_pool.ParallelFor(query.minus_terms_.size(), query.minus_terms_.size(), [&](size_t i) {
+        if (query.minus_terms_[i].document_freqs->count(document_id)) {
+            has_minus_word = true;
+        }
+    });
+    if (has_minus_word || MissesPlusTerm(query, document_id)) {
+        return MatchTuple{matched_words, status};
+    }
+
+    std::vector<char> is_matched(query.plus_terms_.size(), false);
+    thread_pool.ParallelFor(query.plus_terms_.size(), query.plus_terms_.size(), [&](size_t i) {
+        is_matched[i] = query.plus_terms_[i].document_freqs->count(document_id) > 0;
+    });
+
+    std::vector<const PreparedQuery::Term*> matched_terms;
+    for (size_t i = 0; i < is_matched.size(); ++i) {
+        if (is_matched[i]) {
+            matched_terms.push_back(&query.plus_terms_[i]);
+        }
+    }
+
+    return MatchTuple{CollectMatchedWords(matched_terms, document_id), status};
+}
+
+std::vector<std::string_view> SearchServer::CollectMatchedWords(const std::vector<const PreparedQuery::Term*>& matched_terms, int document_id) {
+    std::vector<std::string_view> matched_words;
+    bool has_prefix_terms = false;
+    for (const PreparedQuery::Term* term : matched_terms) {
+        has_prefix_terms |= term->is_prefix;
+        for (auto it = term->first_word; it != term->last_word; ++it) {
+            if (it->second.count(document_id)) {
+                matched_words.push_back(it->first);
+            }
+        }
+    }
+
+    // Обычные слова подготовленного запроса уже отсортированы и уникальны,
+    // а раскрытия префиксов могут совпадать друг с другом и с обычными словами
+    if (has_prefix_terms) {
+        std::sort(matched_words.begin(), matched_words.end());
+        matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+    }
+    return matched_words;
 }
 
 std::vector<int>::const_iterator SearchServer::begin() const {
@@ -124,50 +428,142 @@ void SearchServer::RemoveDocument(int document_id) {
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
-    auto found_document = std::find(document_ids_.begin(), document_ids_.end(), document_id);
-    if (found_document != document_ids_.end()) {
-        document_ids_.erase(found_document);
-        documents_.erase(document_id);
-        std::for_each(word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [document_id] (auto& tmp) { tmp.second.erase(document_id); });
-    }
-    return;
+    RemoveDocumentConcurrent([](auto& document_freqs, const auto& func) {
+            std::for_each(document_freqs.begin(), document_freqs.end(), func);
+        }, document_id);
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
-    auto found_document = std::find(std::execution::par, document_ids_.begin(), document_ids_.end(), document_id);
-    if (found_document != document_ids_.end()) {
-        document_ids_.erase(found_document);
-        documents_.erase(document_id);
-    }
-    return;
+    RemoveDocumentConcurrent([](auto& document_freqs, const auto& func) {
+            std::for_each(std::execution::par, document_freqs.begin(), document_freqs.end(), func);
+        }, document_id);
 }
 
-bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+void SearchServer::RemoveDocument(ThreadPool& thread_pool, int document_id) {
+    // Удаление из списка — один поиск в дереве, поэтому объём работы равен числу слов
+    RemoveDocumentConcurrent([&thread_pool](auto& document_freqs, const auto& func) {
+            thread_pool.ParallelFor(document_freqs.size(), document_freqs.size(), [&document_freqs, &func](size_t i) {
+                func(document_freqs[i]);
+            });
+        }, document_id);
 }
 
-std::string SearchServer::ShieldString(const std::string& str) const {
-    std::string result = ""s;
-    for (char chr : str) {
-        if (chr >= '\0' && chr < ' ') {
-            continue;
-        }
-        result += chr;
+void SortAndTruncate(ThreadPool&, std::vector<Document>& matched_documents) {
+    // Результаты поиска невелики, сортировать их параллельно невыгодно
+    SortAndTruncate(std::execution::seq, matched_documents);
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+    MemoryUsage usage;
+    
+    usage.stop_words = EstimateTreeNodesBytes(stop_words_);
+    for (const std::string& word : stop_words_) {
+        usage.stop_words += EstimateStringHeapBytes(word);
+    }
+    
+    usage.documents = EstimateTreeNodesBytes(documents_);
+    for (const auto& [_, document_data] : documents_) {
+        usage.documents += EstimateStringHeapBytes(document_data.string_data);
+    }
+    usage.documents += text_storages_.capacity() * sizeof(std::shared_ptr<const void>);
+    usage.documents += columns_.ids.capacity() * sizeof(int)
+        + columns_.statuses.capacity() * sizeof(DocumentStatus)
+        + columns_.ratings.capacity() * sizeof(int)
+        + EstimateTreeNodesBytes(columns_.attributes);
+    for (const auto& [name, values] : columns_.attributes) {
+        usage.documents += EstimateStringHeapBytes(name) + values.capacity() * sizeof(int64_t);
+    }
+    
+    usage.words = EstimateTreeNodesBytes(words_);
+    for (const std::string& word : words_) {
+        usage.words += EstimateStringHeapBytes(word);
+    }
+    
+    usage.inverted_index = EstimateTreeNodesBytes(word_to_document_freqs_);
+    for (const auto& [_, document_freqs] : word_to_document_freqs_) {
+        usage.inverted_index += EstimateTreeNodesBytes(document_freqs);
+    }
+    
+    usage.forward_index = EstimateTreeNodesBytes(word_to_document_freqs_ids_);
+    for (const auto& [_, word_freqs] : word_to_document_freqs_ids_) {
+        usage.forward_index += EstimateTreeNodesBytes(word_freqs);
+    }
+    
+    usage.document_ids = document_ids_.capacity() * sizeof(int);
+    
+    if (text_store_ != nullptr) {
+        usage.text_store = text_store_->GetMemoryUsage();
     }
-    return result;
+    
+    return usage;
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument(ShieldString("В слове \""s + std::string(word) + "\" присутствуют недопустимые символы"s));
+void SearchServer::Compact() {
+    // Строки живых документов сдвигаются к началу столбцов на месте, строки удалённых выбрасываются.
+    // Строки обходятся по возрастанию, поэтому новая строка никогда не больше старой
+    // и ещё не перенесённые значения не затираются
+    const uint32_t row_count = static_cast<uint32_t>(columns_.GetRowCount());
+    const uint32_t removed_row = row_count;
+    std::vector<uint32_t> new_rows(row_count, removed_row);
+    for (const auto& [_, document_data] : documents_) {
+        new_rows[document_data.row] = 0;
+    }
+    uint32_t live_row_count = 0;
+    for (uint32_t row = 0; row < row_count; ++row) {
+        if (new_rows[row] == removed_row) {
+            continue;
+        }
+        const uint32_t new_row = live_row_count++;
+        new_rows[row] = new_row;
+        columns_.ids[new_row] = columns_.ids[row];
+        columns_.statuses[new_row] = columns_.statuses[row];
+        columns_.ratings[new_row] = columns_.ratings[row];
+        for (auto& [_, values] : columns_.attributes) {
+            values[new_row] = values[row];
+        }
+    }
+    for (auto& [_, document_data] : documents_) {
+        document_data.row = new_rows[document_data.row];
+    }
+    columns_.ids.resize(live_row_count);
+    columns_.ids.shrink_to_fit();
+    columns_.statuses.resize(live_row_count);
+    columns_.statuses.shrink_to_fit();
+    columns_.ratings.resize(live_row_count);
+    columns_.ratings.shrink_to_fit();
+    for (auto& [_, values] : columns_.attributes) {
+        values.resize(live_row_count);
+        values.shrink_to_fit();
+    }
+    
+    for (auto it = word_to_document_freqs_.begin(); it != word_to_document_freqs_.end();) {
+        if (it->second.empty()) {
+            // Ключ ссылается на словарь, поэтому слово удаляется из словаря последним
+            const auto word = words_.find(it->first);
+            it = word_to_document_freqs_.erase(it);
+            words_.erase(word);
+            continue;
+        }
+        DocumentPostings rebuilt;
+        for (const auto& [document_id, posting] : it->second) {
+            rebuilt.emplace_hint(rebuilt.end(), document_id, DocumentPosting{posting.term_freq, new_rows[posting.row]});
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+        it->second.swap(rebuilt);
+        ++it;
+    }
+    
+    for (auto it = word_to_document_freqs_ids_.begin(); it != word_to_document_freqs_ids_.end();) {
+        if (documents_.count(it->first) == 0) {
+            it = word_to_document_freqs_ids_.erase(it);
+            continue;
         }
+        std::map<std::string_view, double> rebuilt(it->second.begin(), it->second.end());
+        it->second.swap(rebuilt);
+        ++it;
     }
-    return words;
+    
+    document_ids_.shrink_to_fit();
+    ++index_version_;
 }
 
  int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -178,57 +574,102 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_vie
     return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    bool is_minus = false;
+PreparedQuery::Term SearchServer::ResolvePrefix(std::string_view prefix, PreparedQuery& prepared_query) const {
+    PreparedQuery::Term term;
+    term.is_prefix = true;
+    term.first_word = word_to_document_freqs_.lower_bound(prefix);
+    term.last_word = term.first_word;
+    
+    // Слова индекса упорядочены, поэтому все раскрытия префикса идут подряд.
+    // Слова, оставшиеся без документов после удалений, в лимит не засчитываются,
+    // иначе раскрытие зависело бы от истории удалений
+    int expansion_count = 0;
+    while (term.last_word != word_to_document_freqs_.end()
+           && expansion_count < MAX_PREFIX_EXPANSION_COUNT
+           && term.last_word->first.substr(0, prefix.size()) == prefix) {
+        if (!term.last_word->second.empty()) {
+            ++expansion_count;
+        }
+        ++term.last_word;
+    }
+    
+    // k-путевое слияние: документы извлекаются по возрастанию ID,
+    // поэтому каждая вставка в объединённый список идёт в его конец
+    using Cursor = std::pair<PostingIterator, PostingIterator>;
+    const auto cursor_greater = [](const Cursor& lhs, const Cursor& rhs) {
+        return lhs.first->first > rhs.first->first;
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(cursor_greater)> cursors(cursor_greater);
+    for (auto it = term.first_word; it != term.last_word; ++it) {
+        if (!it->second.empty()) {
+            cursors.push({it->second.begin(), it->second.end()});
+        }
+    }
+    
+    auto merged = std::make_shared<DocumentPostings>();
+    while (!cursors.empty()) {
+        Cursor cursor = cursors.top();
+        cursors.pop();
+        if (merged->empty() || merged->rbegin()->first != cursor.first->first) {
+            merged->emplace_hint(merged->end(), cursor.first->first, cursor.first->second);
+        } else {
+            merged->rbegin()->second.term_freq += cursor.first->second.term_freq;
+        }
+        if (++cursor.first != cursor.second) {
+            cursors.push(cursor);
+        }
+    }
     
-    // Word shouldn't be empty
-    if (text[0] == '-') {
-        is_minus = true;
-        text = text.substr(1);
+    term.document_freqs = merged.get();
+    if (!merged->empty()) {
+        term.inverse_document_freq = log(GetDocumentCount() * 1.0 / merged->size());
     }
+    prepared_query.merged_document_freqs_.push_back(std::move(merged));
+    return term;
+}
 
-    if (!IsValidWord(text)) {
-        throw std::invalid_argument(ShieldString("В слове \""s + std::string(text) + "\" запроса содержатся недопустимые символы"s));
+void SearchServer::CheckPreparedQuery(const PreparedQuery& query) const {
+    if (query.search_server_ != this || query.index_version_ != index_version_) {
+        throw std::logic_error("Подготовленный запрос устарел или создан другим сервером"s);
     }
+}
 
-    if (text[0] == '-' || text.size() == 0) {
-        throw std::invalid_argument("В поисковом запросе присутствуют два знака минуса подряд и/или отсутствуют слова после знака минус"s);
+SearchServer::TermPointers SearchServer::GetPlusTermsRarestFirst(const PreparedQuery& query) {
+    TermPointers plus_terms;
+    for (const PreparedQuery::Term& term : query.plus_terms_) {
+        plus_terms.push_back(&term);
     }
-    
-    const QueryWord query_word = {text, is_minus, IsStopWord(text)};
-    return query_word;
+    std::stable_sort(plus_terms.begin(), plus_terms.end(), [](const PreparedQuery::Term* lhs, const PreparedQuery::Term* rhs) {
+        return lhs->document_freqs->size() < rhs->document_freqs->size();
+    });
+    return plus_terms;
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
-    Query query;
-    
-    for (std::string_view word : SplitIntoWords(text)) {
-        QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            }
-            else {
-                query.plus_words.push_back(query_word.data);
-            }
+SearchServer::PostingIterator SearchServer::SeekDocument(const DocumentPostings& document_freqs, PostingIterator cursor, int document_id) {
+    for (int step = 0; step < SEEK_LINEAR_STEP_COUNT; ++step) {
+        if (cursor == document_freqs.end() || cursor->first >= document_id) {
+            return cursor;
         }
+        ++cursor;
     }
-    
-    std::sort(std::execution::par, query.minus_words.begin(), query.minus_words.end());
-    std::sort(std::execution::par, query.plus_words.begin(), query.plus_words.end());
-        
-    query.minus_words.erase(std::unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
-    query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
-    
-    return query;
+    if (cursor == document_freqs.end() || cursor->first >= document_id) {
+        return cursor;
+    }
+    return document_freqs.lower_bound(document_id);
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+bool SearchServer::MissesPlusTerm(const PreparedQuery& query, int document_id) {
+    if (query.mode_ != QueryMode::ALL) {
+        return false;
+    }
+    if (query.has_missing_plus_word_) {
+        return true;
+    }
+    return std::any_of(query.plus_terms_.begin(), query.plus_terms_.end(), [document_id](const PreparedQuery::Term& term) {
+        return term.document_freqs->count(document_id) == 0;
+    });
 }
 
-bool SearchServer::IsValidWord(std::string_view word) {
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-    });
+double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
+    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
 }
\ No newline at end of file
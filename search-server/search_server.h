@@ -7,19 +7,119 @@
 #include <map>
 #include <stdexcept>
 #include <execution>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
 
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "small_vector.h"
+#include "memory_usage.h"
+#include "thread_pool.h"
+#include "document_text_store.h"
+#include "document_filter.h"
+#include "index_log.h"
 
 // Максимальное выводимое кол-во документов
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 // Минимальная погрешность сравнения чисел с плавающей точкой
 const double MIN_COMPARISON_TOLERANCE = 1e-6;
+// Максимальное кол-во слов индекса, в которое раскрывается префиксное слово запроса (например, cat*).
+// Берутся первые по алфавиту слова, у которых есть документы; остальные раскрытия молча отбрасываются,
+// поэтому слишком короткий префикс может найти не все подходящие документы
+const int MAX_PREFIX_EXPANSION_COUNT = 256;
+
+// Сортировка по убыванию релевантности и отсечение MAX_RESULT_DOCUMENT_COUNT лучших.
+// При равных релевантности и рейтинге выше документ с меньшим ID, чтобы порядок
+// не зависел от способа подсчёта
+template <typename ExecutionPolicy>
+void SortAndTruncate(ExecutionPolicy&& policy, std::vector<Document>& matched_documents);
+void SortAndTruncate(ThreadPool& thread_pool, std::vector<Document>& matched_documents);
 
 // Алиас для метода MatchDocument()
 using MatchTuple = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
+// Документ, текст которого хранится вне сервера (например, в отображённом в память файле)
+struct DocumentRecord {
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Где сервер хранит тексты документов. Индекс от текстов не зависит: слова он хранит сам
+enum class TextStorageMode {
+    IN_MEMORY,                  // в памяти сервера, режим по умолчанию
+    DISCARD,                    // тексты не сохраняются
+    EXTERNAL_FILE,              // в файловом хранилище DocumentTextStore
+};
+
+// Как плюс-слова запроса отбирают документы
+enum class QueryMode {
+    ANY,                        // документ содержит хотя бы одно плюс-слово, режим по умолчанию
+    ALL,                        // документ содержит все плюс-слова
+};
+
+// Часы, по которым отсчитываются дедлайны запросов
+using SearchClock = std::chrono::steady_clock;
+
+// Результат поиска с ограничением по времени
+// truncated == true, если дедлайн истёк и ранжирование было прервано досрочно
+struct DeadlineSearchResult {
+    std::vector<Document> documents;
+    bool truncated = false;
+};
+
+// Вхождение слова в документ
+struct DocumentPosting {
+    double term_freq = 0.0;
+    // Строка документа в DocumentColumns сервера
+    uint32_t row = 0;
+};
+
+// Документы слова: ID документа -> вхождение
+using DocumentPostings = std::map<int, DocumentPosting>;
+
+class SearchServer;
+
+// Подготовленный поисковый запрос: слова уже разобраны и сопоставлены спискам документов индекса,
+// IDF посчитаны заранее. Может выполняться многократно с разными предикатами без повторного разбора.
+// Действителен только для создавшего его сервера и до следующего изменения его индекса
+class PreparedQuery {
+public:
+    PreparedQuery() = default;
+
+private:
+    friend class SearchServer;
+
+    // Кол-во слов запроса, хранимых без обращения к куче
+    static constexpr size_t INLINE_TERM_COUNT = 8;
+
+    using WordIterator = std::map<std::string_view, DocumentPostings>::const_iterator;
+
+    struct Term {
+        const DocumentPostings* document_freqs = nullptr;
+        double inverse_document_freq = 0.0;
+        // Слова индекса, которым соответствует слово запроса: одно слово
+        // либо все раскрытия префикса. Нужны для MatchDocument()
+        WordIterator first_word;
+        WordIterator last_word;
+        bool is_prefix = false;
+    };
+
+    SmallVector<Term, INLINE_TERM_COUNT> plus_terms_;
+    SmallVector<Term, INLINE_TERM_COUNT> minus_terms_;
+    QueryMode mode_ = QueryMode::ANY;
+    // В режиме ALL: какого-то плюс-слова нет в индексе, поэтому подходящих документов нет
+    bool has_missing_plus_word_ = false;
+    // Объединённые списки документов префиксных слов, на которые ссылаются их Term
+    std::vector<std::shared_ptr<const DocumentPostings>> merged_document_freqs_;
+    const SearchServer* search_server_ = nullptr;
+    uint64_t index_version_ = 0;
+};
+
 class SearchServer {
 public:
     // Конструктор, принимающий контейнер строк
@@ -34,24 +134,96 @@ public:
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Добавление документов без копирования текста. Тексты записей должны лежать внутри text_storage.
+    // В режиме IN_MEMORY сервер ссылается прямо на text_storage и владеет им до конца своей жизни,
+    // в остальных режимах text_storage после вызова не нужен.
+    // Пачка добавляется целиком: ID (в том числе повторы внутри пачки) и тексты проверяются до изменения
+    // сервера, и при ошибке ни один документ не добавляется. В режиме EXTERNAL_FILE уже записанные
+    // в хранилище тексты при этом остаются в его файле
+    void AddDocuments(std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records);
+    // То же с разбором текстов на слова в потоках thread_pool; индекс заполняется последовательно
+    void AddDocuments(ThreadPool& thread_pool, std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records);
+
+    // В качестве DocumentPredicate можно передать предикат predicate(document_id, status, rating)
+    // либо выражение из фильтров document_filter.h, например StatusEquals(...) && RatingBetween(...).
+    // Фильтры вычисляются сразу для блока документов и работают быстрее предиката.
+    // Префиксное слово (cat*) совпадает лишь с первыми MAX_PREFIX_EXPANSION_COUNT словами индекса
+    // с этим префиксом: документы, содержащие только более поздние по алфавиту раскрытия, не найдутся
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    // В качестве ExecutionPolicy, помимо std::execution::seq/par, можно передать ThreadPool
     template <typename DocumentPredicate, typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
     template <typename ExecutionPolicy>
-    std::vector<Document> FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const;
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
+
+    // Разбор запроса для многократного выполнения.
+    // В режиме QueryMode::ALL найдутся только документы, содержащие все плюс-слова.
+    // Префиксные слова раскрываются здесь же, с тем же ограничением MAX_PREFIX_EXPANSION_COUNT
+    PreparedQuery PrepareQuery(std::string_view raw_query, QueryMode mode = QueryMode::ANY) const;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentPredicate document_predicate) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query) const;
+
+    // Поиск с дедлайном: по его истечении подсчёт релевантности прекращается
+    // и возвращается лучший частичный топ документов с флагом truncated.
+    // mode выбирает режим запроса, как в PrepareQuery
+    template <typename DocumentPredicate>
+    DeadlineSearchResult FindTopDocumentsWithDeadline(std::string_view raw_query, DocumentPredicate document_predicate, SearchClock::time_point deadline,
+                                                      QueryMode mode = QueryMode::ANY) const;
+    DeadlineSearchResult FindTopDocumentsWithDeadline(std::string_view raw_query, DocumentStatus status, SearchClock::time_point deadline,
+                                                      QueryMode mode = QueryMode::ANY) const;
 
     int GetDocumentCount() const;
+
+    // Средний рейтинг документа (0 без оценок), общий с SegmentedSearchServer
+    static int ComputeAverageRating(const std::vector<int>& ratings);
+
+    // Выбор места хранения текстов. Допускается, только пока в сервере нет документов.
+    // Для EXTERNAL_FILE нужно передать хранилище text_store. Хранилище только дописывается:
+    // тексты удалённых документов остаются в его файле, Compact() его не сжимает
+    void SetTextStorage(TextStorageMode mode, std::shared_ptr<DocumentTextStore> text_store = nullptr);
+
+    // Журнал изменений индекса: каждое успешное добавление и удаление документа и изменение атрибута
+    // дописывается в index_log (на диск записи попадают в фоновом потоке журнала).
+    // После сбоя записи журнала изменения отклоняются с std::runtime_error до изменения индекса.
+    // nullptr отключает журнал
+    void SetIndexLog(std::shared_ptr<IndexLog> index_log);
+
+    // Дополнительный числовой атрибут документа для фильтра AttributeBetween.
+    // Незаданный атрибут равен 0
+    void SetDocumentAttribute(int document_id, std::string_view name, int64_t value);
+    int64_t GetDocumentAttribute(int document_id, std::string_view name) const;
+
+    // Текст документа; в режиме EXTERNAL_FILE читается из файла.
+    // В режиме DISCARD тексты недоступны
+    std::string GetDocumentText(int document_id) const;
     
     MatchTuple MatchDocument(std::string_view raw_query, int document_id) const;
     MatchTuple MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     MatchTuple MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
+    MatchTuple MatchDocument(ThreadPool& thread_pool, std::string_view raw_query, int document_id) const;
+
+    MatchTuple MatchDocument(const PreparedQuery& query, int document_id) const;
+    MatchTuple MatchDocument(const std::execution::sequenced_policy&, const PreparedQuery& query, int document_id) const;
+    MatchTuple MatchDocument(const std::execution::parallel_policy&, const PreparedQuery& query, int document_id) const;
+    MatchTuple MatchDocument(ThreadPool& thread_pool, const PreparedQuery& query, int document_id) const;
     
     std::vector<int>::const_iterator begin() const;
     std::vector<int>::const_iterator end() const;
@@ -61,57 +233,154 @@ public:
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
+    void RemoveDocument(ThreadPool& thread_pool, int document_id);
+
+    // Оценка памяти по структурам сервера. Внешние хранилища текстов (см. AddDocuments) не учитываются
+    MemoryUsage GetMemoryUsage() const;
+
+    // Удаляет слова, не встречающиеся ни в одном документе, и остатки удалённых документов,
+    // включая их строки в столбцах метаданных, после чего перестраивает списки документов
+    // по одному, чтобы узлы каждого лежали рядом.
+    // Столбцы метаданных сжимаются на месте; пиковый расход памяти сверх текущего —
+    // самый большой список или столбец и таблица перенумерации строк (4 байта на строку).
+    // Делает недействительными подготовленные запросы
+    void Compact();
 
 private:
     struct DocumentData {
-        int rating;
-        DocumentStatus status;
+        // Строка документа в columns_
+        uint32_t row;
+        // Режим IN_MEMORY: собственная копия текста; пуста, если текст лежит во внешнем хранилище
         std::string string_data;
+        // Режим IN_MEMORY: указывает либо на string_data, либо во внешнее хранилище
+        std::string_view text;
+        // Режим EXTERNAL_FILE: положение текста в text_store_
+        DocumentTextStore::Location text_location;
     };
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    // Слова всех документов. Ключи индексов ссылаются сюда, а не в тексты документов
+    std::set<std::string, std::less<>> words_;
+    std::map<std::string_view, DocumentPostings> word_to_document_freqs_;
     std::map<int, std::map<std::string_view, double>> word_to_document_freqs_ids_;
     std::map<int, DocumentData> documents_;
+    // Статус, рейтинг и атрибуты документов. Строки удалённых документов остаются до Compact()
+    DocumentColumns columns_;
     std::vector<int> document_ids_;
+    TextStorageMode text_storage_mode_ = TextStorageMode::IN_MEMORY;
+    // Внешние хранилища текстов, на которые ссылаются documents_ (режим IN_MEMORY)
+    std::vector<std::shared_ptr<const void>> text_storages_;
+    std::shared_ptr<DocumentTextStore> text_store_;
+    std::shared_ptr<IndexLog> index_log_;
+    // Увеличивается при каждом изменении индекса, делая недействительными подготовленные запросы
+    uint64_t index_version_ = 0;
+
+    void CheckNewDocumentId(int document_id) const;
+    // Бросает исключение, если подключённый журнал больше не записывается
+    void CheckIndexLogWritable() const;
+
+    // Данные нового документа; текст сохраняется согласно text_storage_mode_.
+    // В режиме IN_MEMORY text ссылается на переданный текст без копирования.
+    // Строку в columns_ назначает вызывающий, когда все проверки уже пройдены
+    DocumentData MakeDocumentData(std::string_view text);
+
+    // Заполнение прямого и обратного индексов по тексту уже зарегистрированного документа
+    void IndexDocument(int document_id, const std::vector<std::string_view>& words);
+
+    // Общая часть версий AddDocuments: document_words[i] — слова текста records[i]
+    void AddDocumentsSplit(std::shared_ptr<const void> text_storage, const std::vector<DocumentRecord>& records,
+                           const std::vector<std::vector<std::string_view>>& document_words);
 
-    bool IsStopWord(std::string_view word) const;
+    struct Query {
+        SmallVector<std::string_view, PreparedQuery::INLINE_TERM_COUNT> plus_words;
+        SmallVector<std::string_view, PreparedQuery::INLINE_TERM_COUNT> minus_words;
+    };
 
-    // Удаляет вхождения недопустимых символов в строку
-    // Необходима для передачи в throw и корректного вывода (иначе на нулевом терминаторе строка обрывается)
-    std::string ShieldString(const std::string& str) const;
+    // Раскрытие префикса в слова индекса (не более MAX_PREFIX_EXPANSION_COUNT)
+    // и слияние их списков документов в один. Частоты слов в документе складываются
+    PreparedQuery::Term ResolvePrefix(std::string_view prefix, PreparedQuery& prepared_query) const;
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    // Проверка, что подготовленный запрос создан этим сервером и индекс с тех пор не менялся
+    void CheckPreparedQuery(const PreparedQuery& query) const;
 
-    static int ComputeAverageRating(const std::vector<int>& ratings);
+    // Вычисление TF-IDF
+    double ComputeWordInverseDocumentFreq(std::string_view word) const;
 
-    struct QueryWord {
-        std::string_view data;
-        bool is_minus;
-        bool is_stop;
+    // Релевантность документа и его строка в columns_
+    struct ScoredRow {
+        double relevance = 0.0;
+        uint32_t row = 0;
     };
 
-    // Проверка слова в поисковом запросе
-    QueryWord ParseQueryWord(std::string_view text) const;
-
-    struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+    // Блок подряд идущих документов из списка слова
+    struct PostingBlock {
+        size_t size = 0;
+        int document_ids[FILTER_BLOCK_SIZE];
+        uint32_t rows[FILTER_BLOCK_SIZE];
+        double term_freqs[FILTER_BLOCK_SIZE];
+        // Результат фильтра для каждого документа блока
+        char mask[FILTER_BLOCK_SIZE];
     };
 
-    // Проверка поискового запроса
-    Query ParseQuery(std::string_view text) const;
-
-    // Вычисление TF-IDF
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
-
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
-    
-    static bool IsValidWord(std::string_view word);
+    // Обходит список документов блоками по FILTER_BLOCK_SIZE, вычисляя фильтр сразу для всего блока.
+    // func(block) возвращает false, чтобы прервать обход
+    template <typename Filter, typename Func>
+    void ForEachPostingBlock(const DocumentPostings& postings, const Filter& filter, Func func) const;
+
+    // Фильтр — выражение из document_filter.h (см. MakeDocumentFilter)
+    template <typename Filter>
+    std::vector<Document> FindAllDocuments(const PreparedQuery& query, const Filter& filter) const;
+    template <typename Filter>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const PreparedQuery& query, const Filter& filter) const;
+    template <typename Filter>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const PreparedQuery& query, const Filter& filter) const;
+    template <typename Filter>
+    std::vector<Document> FindAllDocuments(ThreadPool& thread_pool, const PreparedQuery& query, const Filter& filter) const;
+
+    // Общая часть параллельных версий: for_each_term(terms, func) вызывает func для каждого слова,
+    // возможно, из разных потоков
+    template <typename ForEachTerm, typename Filter>
+    std::vector<Document> FindAllDocumentsConcurrent(ForEachTerm for_each_term, const PreparedQuery& query, const Filter& filter) const;
+
+    // Через сколько обработанных вхождений слова проверяется дедлайн
+    static constexpr int DEADLINE_CHECK_PERIOD = 1024;
+
+    // Последовательный подсчёт релевантности, прерываемый по дедлайну.
+    // Дедлайн проверяется и до начала подсчёта
+    template <typename Filter>
+    std::vector<Document> FindAllDocumentsUntil(const PreparedQuery& query, const Filter& filter, SearchClock::time_point deadline, bool& truncated) const;
+
+    // Режим QueryMode::ALL: пересечение списков документов от самого короткого к самому длинному,
+    // поэтому стоимость определяется самым редким словом. Выполняется последовательно
+    // во всех версиях FindAllDocuments — самый короткий список обычно невелик
+    template <typename Filter>
+    std::vector<Document> FindAllDocumentsConjunctive(const PreparedQuery& query, const Filter& filter, SearchClock::time_point deadline, bool& truncated) const;
+
+    using PostingIterator = DocumentPostings::const_iterator;
+    // Списки по словам запроса; обычные запросы укладываются в них без обращения к куче
+    using TermPointers = SmallVector<const PreparedQuery::Term*, PreparedQuery::INLINE_TERM_COUNT>;
+    using PostingCursors = SmallVector<PostingIterator, PreparedQuery::INLINE_TERM_COUNT>;
+
+    // Плюс-слова запроса по возрастанию длины списка документов, т.е. по убыванию IDF
+    static TermPointers GetPlusTermsRarestFirst(const PreparedQuery& query);
+
+    // Сколько документов курсор перебирает по одному, прежде чем искать спуском по дереву
+    static constexpr int SEEK_LINEAR_STEP_COUNT = 8;
+
+    // Продвигает курсор к первому документу с ID не меньше document_id.
+    // Близкие документы перебираются по одному, далёкие ищутся за логарифм
+    static PostingIterator SeekDocument(const DocumentPostings& document_freqs, PostingIterator cursor, int document_id);
+
+    // Слова индекса, которыми совпавшие с документом плюс-слова (для префикса — его раскрытия)
+    // в нём встречаются, по возрастанию и без повторов
+    static std::vector<std::string_view> CollectMatchedWords(const std::vector<const PreparedQuery::Term*>& matched_terms, int document_id);
+
+    // В режиме QueryMode::ALL — документ не содержит какого-то плюс-слова запроса
+    static bool MissesPlusTerm(const PreparedQuery& query, int document_id);
+
+    // Общая часть всех версий RemoveDocument: документ удаляется только из списков своих слов.
+    // for_each_list(lists, func) вызывает func для каждого списка, возможно, из разных потоков
+    template <typename ForEachList>
+    void RemoveDocumentConcurrent(ForEachList for_each_list, int document_id);
 };
 
 template <typename StringContainer>
@@ -129,14 +398,45 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 }
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const Query query = ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(policy, PrepareQuery(raw_query), document_predicate);
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, query, document_predicate);
+}
 
+template <typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentPredicate document_predicate) const {
+    CheckPreparedQuery(query);
+
+    auto matched_documents = FindAllDocuments(policy, query, MakeDocumentFilter(document_predicate));
+    SortAndTruncate(policy, matched_documents);
+    
+    return matched_documents;
+}
+
+template <typename DocumentPredicate>
+DeadlineSearchResult SearchServer::FindTopDocumentsWithDeadline(std::string_view raw_query, DocumentPredicate document_predicate, SearchClock::time_point deadline,
+                                                               QueryMode mode) const {
+    const PreparedQuery query = PrepareQuery(raw_query, mode);
+
+    DeadlineSearchResult result;
+    result.documents = FindAllDocumentsUntil(query, MakeDocumentFilter(document_predicate), deadline, result.truncated);
+    SortAndTruncate(std::execution::seq, result.documents);
+
+    return result;
+}
+
+template <typename ExecutionPolicy>
+void SortAndTruncate(ExecutionPolicy&& policy, std::vector<Document>& matched_documents) {
     sort(policy, matched_documents.begin(), matched_documents.end(),
          [](const Document& lhs, const Document& rhs) {
              if (std::abs(lhs.relevance - rhs.relevance) < MIN_COMPARISON_TOLERANCE) {
+                 if (lhs.rating == rhs.rating) {
+                     return lhs.id < rhs.id;
+                 }
                  return lhs.rating > rhs.rating;
              } else {
                  return lhs.relevance > rhs.relevance;
@@ -146,99 +446,288 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
-    
-    return matched_documents;
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-        });
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(policy, raw_query, StatusEquals(status));
 }
 
 template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy policy, std::string_view raw_query) const {
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query, DocumentStatus status) const {
+    return FindTopDocuments(policy, query, StatusEquals(status));
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const PreparedQuery& query) const {
+    return FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+}
+
+template <typename Filter, typename Func>
+void SearchServer::ForEachPostingBlock(const DocumentPostings& postings, const Filter& filter, Func func) const {
+    PostingBlock block;
+    auto posting = postings.begin();
+    while (posting != postings.end()) {
+        block.size = 0;
+        for (; posting != postings.end() && block.size < FILTER_BLOCK_SIZE; ++posting, ++block.size) {
+            block.document_ids[block.size] = posting->first;
+            block.rows[block.size] = posting->second.row;
+            block.term_freqs[block.size] = posting->second.term_freq;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+        filter.EvaluateBlock(columns_, block.rows, block.size, block.mask);
+        if (!func(block)) {
+            return;
         }
     }
+}
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocuments(const PreparedQuery& query, const Filter& filter) const {
+    return FindAllDocuments(std::execution::seq, query, filter);
+}
+
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const PreparedQuery& query, const Filter& filter) const {
+    bool truncated = false;
+    return FindAllDocumentsUntil(query, filter, SearchClock::time_point::max(), truncated);
+}
+
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocumentsUntil(const PreparedQuery& query, const Filter& filter, SearchClock::time_point deadline, bool& truncated) const {
+    const bool has_deadline = deadline != SearchClock::time_point::max();
+    // Иначе запрос с уже истёкшим дедлайном успевал бы обработать первые DEADLINE_CHECK_PERIOD вхождений
+    if (has_deadline && SearchClock::now() >= deadline) {
+        truncated = true;
+        return {};
+    }
+    if (query.mode_ == QueryMode::ALL) {
+        return FindAllDocumentsConjunctive(query, filter, deadline, truncated);
+    }
+
+    std::map<int, ScoredRow> document_to_relevance;
+    int postings_until_check = DEADLINE_CHECK_PERIOD;
+
+    // При срабатывании дедлайна частичный результат учитывает самые информативные слова
+    for (const PreparedQuery::Term* term : GetPlusTermsRarestFirst(query)) {
+        ForEachPostingBlock(*term->document_freqs, filter, [&](const PostingBlock& block) {
+            for (size_t i = 0; i < block.size; ++i) {
+                if (block.mask[i]) {
+                    ScoredRow& scored_row = document_to_relevance[block.document_ids[i]];
+                    scored_row.relevance += block.term_freqs[i] * term->inverse_document_freq;
+                    scored_row.row = block.rows[i];
+                }
+            }
+            // Дедлайн проверяется между блоками
+            if (has_deadline && (postings_until_check -= static_cast<int>(block.size)) <= 0) {
+                postings_until_check = DEADLINE_CHECK_PERIOD;
+                truncated = SearchClock::now() >= deadline;
+            }
+            return !truncated;
+        });
+        if (truncated) {
+            break;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
+    }
+
+    // Минус-слова применяются всегда, даже к частичному результату,
+    // чтобы в выдачу не попадали заведомо исключённые документы
+    for (const PreparedQuery::Term& term : query.minus_terms_) {
+        for (const auto& [document_id, _] : *term.document_freqs) {
             document_to_relevance.erase(document_id);
         }
     }
 
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
+    for (const auto& [document_id, scored_row] : document_to_relevance) {
         matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+            {document_id, scored_row.relevance, columns_.ratings[scored_row.row]});
     }
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    constexpr int BUCKETS_NUMBER = 101;
-    ConcurrentMap<int, double> document_to_relevance(BUCKETS_NUMBER);
-    
-    const auto fill_plus_words_func = [this, &document_predicate, &document_to_relevance] (std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(const PreparedQuery& query, const Filter& filter, SearchClock::time_point deadline, bool& truncated) const {
+    std::vector<Document> matched_documents;
+    if (query.has_missing_plus_word_ || query.plus_terms_.size() == 0) {
+        return matched_documents;
+    }
+
+    const TermPointers plus_terms = GetPlusTermsRarestFirst(query);
+
+    // Курсоры остальных списков только движутся вперёд, как и обход самого короткого
+    PostingCursors plus_cursors;
+    for (const PreparedQuery::Term* term : plus_terms) {
+        plus_cursors.push_back(term->document_freqs->begin());
+    }
+    PostingCursors minus_cursors;
+    for (const PreparedQuery::Term& term : query.minus_terms_) {
+        minus_cursors.push_back(term.document_freqs->begin());
+    }
+
+    const bool has_deadline = deadline != SearchClock::time_point::max();
+    int postings_until_check = DEADLINE_CHECK_PERIOD;
+
+    // Документы пересечения; фильтр к ним применяется потом, блоками
+    std::vector<int> candidate_ids;
+    std::vector<uint32_t> candidate_rows;
+    std::vector<double> candidate_relevances;
+
+    const PreparedQuery::Term& shortest_term = *plus_terms[0];
+    for (const auto& [document_id, posting] : *shortest_term.document_freqs) {
+        if (has_deadline && --postings_until_check == 0) {
+            postings_until_check = DEADLINE_CHECK_PERIOD;
+            if (SearchClock::now() >= deadline) {
+                truncated = true;
+                break;
+            }
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+
+        double relevance = posting.term_freq * shortest_term.inverse_document_freq;
+        bool is_matched = true;
+        bool is_exhausted = false;
+        for (size_t i = 1; i < plus_terms.size(); ++i) {
+            const DocumentPostings& document_freqs = *plus_terms[i]->document_freqs;
+            plus_cursors[i] = SeekDocument(document_freqs, plus_cursors[i], document_id);
+            if (plus_cursors[i] == document_freqs.end()) {
+                is_exhausted = true;
+            }
+            if (is_exhausted || plus_cursors[i]->first != document_id) {
+                is_matched = false;
+                break;
             }
+            relevance += plus_cursors[i]->second.term_freq * plus_terms[i]->inverse_document_freq;
         }
-    };
-    
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), fill_plus_words_func);
-    
-    const auto fill_minus_words_func = [this, &document_to_relevance] (std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+        // В одном из списков документов с большими ID не осталось
+        if (is_exhausted) {
+            break;
+        }
+        if (!is_matched) {
+            continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
+
+        for (size_t i = 0; i < minus_cursors.size() && is_matched; ++i) {
+            const DocumentPostings& document_freqs = *query.minus_terms_[i].document_freqs;
+            minus_cursors[i] = SeekDocument(document_freqs, minus_cursors[i], document_id);
+            is_matched = minus_cursors[i] == document_freqs.end() || minus_cursors[i]->first != document_id;
+        }
+        if (is_matched) {
+            candidate_ids.push_back(document_id);
+            candidate_rows.push_back(posting.row);
+            candidate_relevances.push_back(relevance);
+        }
+    }
+
+    char mask[FILTER_BLOCK_SIZE];
+    for (size_t begin = 0; begin < candidate_ids.size(); begin += FILTER_BLOCK_SIZE) {
+        const size_t count = std::min(FILTER_BLOCK_SIZE, candidate_ids.size() - begin);
+        filter.EvaluateBlock(columns_, candidate_rows.data() + begin, count, mask);
+        for (size_t i = 0; i < count; ++i) {
+            if (mask[i]) {
+                matched_documents.push_back(
+                    {candidate_ids[begin + i], candidate_relevances[begin + i], columns_.ratings[candidate_rows[begin + i]]});
+            }
+        }
+    }
+    return matched_documents;
+}
+
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const PreparedQuery& query, const Filter& filter) const {
+    if (query.mode_ == QueryMode::ALL) {
+        return FindAllDocuments(std::execution::seq, query, filter);
+    }
+    return FindAllDocumentsConcurrent([](const auto& terms, const auto& func) {
+            std::for_each(std::execution::par, terms.begin(), terms.end(), func);
+        }, query, filter);
+}
+
+template <typename Filter>
+std::vector<Document> SearchServer::FindAllDocuments(ThreadPool& thread_pool, const PreparedQuery& query, const Filter& filter) const {
+    if (query.mode_ == QueryMode::ALL) {
+        return FindAllDocuments(std::execution::seq, query, filter);
+    }
+    return FindAllDocumentsConcurrent([&thread_pool](const auto& terms, const auto& func) {
+            size_t posting_count = 0;
+            for (const PreparedQuery::Term& term : terms) {
+                posting_count += term.document_freqs->size();
+            }
+            thread_pool.ParallelFor(terms.size(), posting_count, [&terms, &func](size_t i) {
+                func(terms[i]);
+            });
+        }, query, filter);
+}
+
+template <typename ForEachTerm, typename Filter>
+std::vector<Document> SearchServer::FindAllDocumentsConcurrent(ForEachTerm for_each_term, const PreparedQuery& query, const Filter& filter) const {
+    constexpr int BUCKETS_NUMBER = 101;
+    ConcurrentMap<int, ScoredRow> document_to_relevance(BUCKETS_NUMBER);
+
+    const auto fill_plus_words_func = [this, &filter, &document_to_relevance] (const PreparedQuery::Term& term) {
+        ForEachPostingBlock(*term.document_freqs, filter, [&term, &document_to_relevance](const PostingBlock& block) {
+            for (size_t i = 0; i < block.size; ++i) {
+                if (block.mask[i]) {
+                    auto access = document_to_relevance[block.document_ids[i]];
+                    access.ref_to_value.relevance += block.term_freqs[i] * term.inverse_document_freq;
+                    access.ref_to_value.row = block.rows[i];
+                }
+            }
+            return true;
+        });
+    };
+
+    for_each_term(query.plus_terms_, fill_plus_words_func);
+
+    const auto fill_minus_words_func = [&document_to_relevance] (const PreparedQuery::Term& term) {
+        for (const auto& [document_id, _] : *term.document_freqs) {
             document_to_relevance.erase(document_id);
         }
     };
-    
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), fill_minus_words_func);
-    
+
+    for_each_term(query.minus_terms_, fill_minus_words_func);
+
     const auto ordinary_map = document_to_relevance.BuildOrdinaryMap();
 
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : ordinary_map) {
+    for (const auto& [document_id, scored_row] : ordinary_map) {
         matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+            {document_id, scored_row.relevance, columns_.ratings[scored_row.row]});
     }
-    
+
     return matched_documents;
+}
+
+template <typename ForEachList>
+void SearchServer::RemoveDocumentConcurrent(ForEachList for_each_list, int document_id) {
+    auto found_document = std::find(document_ids_.begin(), document_ids_.end(), document_id);
+    if (found_document == document_ids_.end()) {
+        return;
+    }
+    CheckIndexLogWritable();
+
+    // Списки разных слов независимы, поэтому их можно обрабатывать одновременно
+    const auto word_freqs = word_to_document_freqs_ids_.find(document_id);
+    if (word_freqs != word_to_document_freqs_ids_.end()) {
+        std::vector<DocumentPostings*> document_freqs;
+        document_freqs.reserve(word_freqs->second.size());
+        for (const auto& [word, _] : word_freqs->second) {
+            document_freqs.push_back(&word_to_document_freqs_.at(word));
+        }
+        for_each_list(document_freqs, [document_id](DocumentPostings* freqs) {
+            freqs->erase(document_id);
+        });
+        word_to_document_freqs_ids_.erase(word_freqs);
+    }
+
+    document_ids_.erase(found_document);
+    documents_.erase(document_id);
+    ++index_version_;
+
+    if (index_log_) {
+        index_log_->AppendRemoveDocument(document_id);
+    }
 }
\ No newline at end of file
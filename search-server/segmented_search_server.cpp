@@ -0,0 +1,396 @@
+#include "segmented_search_server.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+constexpr uint32_t NO_ORDINAL = UINT32_MAX;
+
+} // namespace
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string& stop_words_text, size_t mutable_segment_size)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), mutable_segment_size) {
+}
+
+SegmentedSearchServer::SegmentedSearchServer(std::string_view stop_words_text, size_t mutable_segment_size)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), mutable_segment_size) {
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        std::lock_guard lock(merge_mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    merge_thread_.join();
+}
+
+SegmentedSearchServer::Segment::Segment(size_t document_count)
+    : tombstones((document_count + 63) / 64) {
+}
+
+bool SegmentedSearchServer::Segment::IsRemoved(uint32_t ordinal) const {
+    return (tombstones[ordinal / 64].load(std::memory_order_relaxed) >> (ordinal % 64)) & 1;
+}
+
+void SegmentedSearchServer::Segment::MarkRemoved(uint32_t ordinal) {
+    const uint64_t bit = uint64_t(1) << (ordinal % 64);
+    if ((tombstones[ordinal / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0) {
+        ++removed_count;
+    }
+}
+
+size_t SegmentedSearchServer::Segment::GetLiveCount() const {
+    return document_ids.size() - removed_count;
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    if (document_id < 0) {
+        throw std::invalid_argument("ID документа не должен быть отрицательным"s);
+    }
+    // Разбор текста не требует блокировки индекса
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document, stop_words_);
+    const double inv_word_count = 1.0 / words.size();
+    const int rating = SearchServer::ComputeAverageRating(ratings);
+
+    bool sealed = false;
+    {
+        std::unique_lock lock(index_mutex_);
+        if (documents_.count(document_id)) {
+            throw std::invalid_argument("Такой ID документа уже существует"s);
+        }
+        uint32_t row;
+        if (free_rows_.empty()) {
+            row = columns_.Append(document_id, status, rating);
+        } else {
+            row = free_rows_.back();
+            free_rows_.pop_back();
+            columns_.ids[row] = document_id;
+            columns_.statuses[row] = status;
+            columns_.ratings[row] = rating;
+        }
+        documents_.emplace(document_id, DocumentData{row});
+        std::vector<std::string_view>& document_words = mutable_document_words_[document_id];
+        for (std::string_view word : words) {
+            auto found = mutable_segment_.find(word);
+            if (found == mutable_segment_.end()) {
+                found = mutable_segment_.emplace(std::string(word), std::map<int, double>{}).first;
+            }
+            const auto [document_freq, inserted] = found->second.emplace(document_id, 0.0);
+            document_freq->second += inv_word_count;
+            if (inserted) {
+                document_words.push_back(found->first);
+            }
+        }
+        if (mutable_document_words_.size() >= mutable_segment_size_) {
+            SealLocked();
+            sealed = true;
+        }
+    }
+    if (sealed) {
+        RequestMerge();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    std::unique_lock lock(index_mutex_);
+    const auto document = documents_.find(document_id);
+    if (document == documents_.end()) {
+        return;
+    }
+    free_rows_.push_back(document->second.row);
+    documents_.erase(document);
+
+    const auto document_words = mutable_document_words_.find(document_id);
+    if (document_words != mutable_document_words_.end()) {
+        // Из изменяемого сегмента документ удаляется сразу, и только из списков своих слов
+        for (std::string_view word : document_words->second) {
+            const auto found = mutable_segment_.find(word);
+            found->second.erase(document_id);
+            if (found->second.empty()) {
+                mutable_segment_.erase(found);
+            }
+        }
+        mutable_document_words_.erase(document_words);
+        return;
+    }
+
+    for (const auto& segment : segments_) {
+        const auto found = std::lower_bound(segment->document_ids.begin(), segment->document_ids.end(), document_id);
+        if (found == segment->document_ids.end() || *found != document_id) {
+            continue;
+        }
+        const uint32_t ordinal = found - segment->document_ids.begin();
+        // После повторного добавления ID может встречаться и в старом сегменте, уже как удалённый
+        if (segment->IsRemoved(ordinal)) {
+            continue;
+        }
+        segment->MarkRemoved(ordinal);
+        if (merge_in_progress_) {
+            removed_during_merge_.push_back(document_id);
+        }
+        return;
+    }
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, StatusEquals(status));
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+void SegmentedSearchServer::CollectWordPostings(std::string_view word, std::vector<std::pair<int, double>>& word_postings) const {
+    word_postings.clear();
+    const auto append = [&word_postings](int document_id, double term_freq) {
+        word_postings.emplace_back(document_id, term_freq);
+    };
+    if (word.back() != '*') {
+        ForEachLivePosting(word, append);
+        return;
+    }
+
+    const std::string_view prefix = word.substr(0, word.size() - 1);
+    const auto has_prefix = [prefix](std::string_view candidate) {
+        return candidate.substr(0, prefix.size()) == prefix;
+    };
+    // Одно слово может быть в нескольких сегментах, поэтому раскрытия собираются в общее упорядоченное множество
+    std::set<std::string_view> expansions;
+    for (const auto& segment : segments_) {
+        auto it = std::lower_bound(segment->words.begin(), segment->words.end(), prefix,
+                                   [](const std::string& lhs, std::string_view rhs) { return lhs < rhs; });
+        for (; it != segment->words.end() && has_prefix(*it); ++it) {
+            expansions.insert(*it);
+        }
+    }
+    for (auto it = mutable_segment_.lower_bound(prefix); it != mutable_segment_.end() && has_prefix(it->first); ++it) {
+        expansions.insert(it->first);
+    }
+
+    // Слова, все документы которых удалены, в лимит не засчитываются, как и в SearchServer
+    int expansion_count = 0;
+    for (std::string_view expansion : expansions) {
+        if (expansion_count == MAX_PREFIX_EXPANSION_COUNT) {
+            break;
+        }
+        const size_t posting_count = word_postings.size();
+        ForEachLivePosting(expansion, append);
+        if (word_postings.size() != posting_count) {
+            ++expansion_count;
+        }
+    }
+
+    std::sort(word_postings.begin(), word_postings.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+    size_t merged_count = 0;
+    for (size_t i = 0; i < word_postings.size(); ++i) {
+        if (merged_count != 0 && word_postings[merged_count - 1].first == word_postings[i].first) {
+            word_postings[merged_count - 1].second += word_postings[i].second;
+        } else {
+            word_postings[merged_count++] = word_postings[i];
+        }
+    }
+    word_postings.resize(merged_count);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    std::shared_lock lock(index_mutex_);
+    return documents_.size();
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    std::shared_lock lock(index_mutex_);
+    return segments_.size();
+}
+
+void SegmentedSearchServer::Seal() {
+    {
+        std::unique_lock lock(index_mutex_);
+        SealLocked();
+    }
+    RequestMerge();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    std::unique_lock lock(merge_mutex_);
+    merge_cv_.wait(lock, [this] { return !merge_requested_ && !merge_running_; });
+}
+
+void SegmentedSearchServer::SealLocked() {
+    if (mutable_document_words_.empty()) {
+        return;
+    }
+    segments_.push_back(BuildSegment(mutable_segment_, mutable_document_words_));
+    mutable_segment_.clear();
+    mutable_document_words_.clear();
+}
+
+void SegmentedSearchServer::RequestMerge() {
+    {
+        std::lock_guard lock(merge_mutex_);
+        merge_requested_ = true;
+    }
+    merge_cv_.notify_all();
+}
+
+std::shared_ptr<SegmentedSearchServer::Segment> SegmentedSearchServer::BuildSegment(const std::map<std::string, std::map<int, double>, std::less<>>& word_to_document_freqs,
+                                                                                    const std::map<int, std::vector<std::string_view>>& document_words) {
+    auto segment = std::make_shared<Segment>(document_words.size());
+    segment->document_ids.reserve(document_words.size());
+    for (const auto& [document_id, _] : document_words) {
+        segment->document_ids.push_back(document_id);
+    }
+    segment->words.reserve(word_to_document_freqs.size());
+    segment->word_offsets.reserve(word_to_document_freqs.size() + 1);
+
+    for (const auto& [word, document_freqs] : word_to_document_freqs) {
+        segment->words.push_back(word);
+        segment->word_offsets.push_back(segment->postings.size());
+        for (const auto [document_id, term_freq] : document_freqs) {
+            const auto ordinal = std::lower_bound(segment->document_ids.begin(), segment->document_ids.end(), document_id) - segment->document_ids.begin();
+            segment->postings.push_back({static_cast<uint32_t>(ordinal), term_freq});
+        }
+    }
+    segment->word_offsets.push_back(segment->postings.size());
+    return segment;
+}
+
+std::shared_ptr<SegmentedSearchServer::Segment> SegmentedSearchServer::MergeSegments(const std::vector<std::shared_ptr<Segment>>& sources) {
+    // Маска удалённых читается один раз: документы, удалённые позже, учтёт InstallMergedSegment()
+    std::vector<int> document_ids;
+    std::vector<std::vector<uint32_t>> live_ordinals(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const Segment& source = *sources[i];
+        live_ordinals[i].resize(source.document_ids.size(), NO_ORDINAL);
+        for (uint32_t ordinal = 0; ordinal < source.document_ids.size(); ++ordinal) {
+            if (!source.IsRemoved(ordinal)) {
+                live_ordinals[i][ordinal] = 0;
+                document_ids.push_back(source.document_ids[ordinal]);
+            }
+        }
+    }
+    std::sort(document_ids.begin(), document_ids.end());
+
+    auto merged = std::make_shared<Segment>(document_ids.size());
+    merged->document_ids = std::move(document_ids);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (uint32_t ordinal = 0; ordinal < live_ordinals[i].size(); ++ordinal) {
+            if (live_ordinals[i][ordinal] != NO_ORDINAL) {
+                const int document_id = sources[i]->document_ids[ordinal];
+                live_ordinals[i][ordinal] = std::lower_bound(merged->document_ids.begin(), merged->document_ids.end(), document_id) - merged->document_ids.begin();
+            }
+        }
+    }
+
+    std::map<std::string_view, std::vector<Posting>> word_to_postings;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        const Segment& source = *sources[i];
+        for (size_t word_index = 0; word_index < source.words.size(); ++word_index) {
+            for (size_t p = source.word_offsets[word_index]; p < source.word_offsets[word_index + 1]; ++p) {
+                const uint32_t ordinal = live_ordinals[i][source.postings[p].ordinal];
+                if (ordinal != NO_ORDINAL) {
+                    word_to_postings[source.words[word_index]].push_back({ordinal, source.postings[p].term_freq});
+                }
+            }
+        }
+    }
+
+    merged->words.reserve(word_to_postings.size());
+    merged->word_offsets.reserve(word_to_postings.size() + 1);
+    for (auto& [word, postings] : word_to_postings) {
+        std::sort(postings.begin(), postings.end(), [](const Posting& lhs, const Posting& rhs) {
+            return lhs.ordinal < rhs.ordinal;
+        });
+        merged->words.emplace_back(word);
+        merged->word_offsets.push_back(merged->postings.size());
+        merged->postings.insert(merged->postings.end(), postings.begin(), postings.end());
+    }
+    merged->word_offsets.push_back(merged->postings.size());
+    return merged;
+}
+
+size_t SegmentedSearchServer::GetSizeTier(size_t document_count, size_t base_size) {
+    size_t tier = 0;
+    size_t tier_capacity = base_size;
+    while (document_count > tier_capacity) {
+        tier_capacity *= MERGE_FACTOR;
+        ++tier;
+    }
+    return tier;
+}
+
+std::vector<std::shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::PickMergeCandidates() {
+    // Полностью удалённые сегменты сливать незачем — они просто выбрасываются
+    segments_.erase(std::remove_if(segments_.begin(), segments_.end(), [](const auto& segment) {
+                        return segment->GetLiveCount() == 0;
+                    }), segments_.end());
+
+    std::map<size_t, std::vector<std::shared_ptr<Segment>>> tiers;
+    for (const auto& segment : segments_) {
+        auto& tier = tiers[GetSizeTier(segment->GetLiveCount(), mutable_segment_size_)];
+        tier.push_back(segment);
+        if (tier.size() == MERGE_FACTOR) {
+            merge_in_progress_ = true;
+            removed_during_merge_.clear();
+            return tier;
+        }
+    }
+    return {};
+}
+
+void SegmentedSearchServer::InstallMergedSegment(const std::vector<std::shared_ptr<Segment>>& sources, std::shared_ptr<Segment> merged) {
+    for (const int document_id : removed_during_merge_) {
+        const auto found = std::lower_bound(merged->document_ids.begin(), merged->document_ids.end(), document_id);
+        if (found != merged->document_ids.end() && *found == document_id) {
+            merged->MarkRemoved(found - merged->document_ids.begin());
+        }
+    }
+    removed_during_merge_.clear();
+    merge_in_progress_ = false;
+
+    segments_.erase(std::remove_if(segments_.begin(), segments_.end(), [&sources](const auto& segment) {
+                        return std::find(sources.begin(), sources.end(), segment) != sources.end();
+                    }), segments_.end());
+    if (merged->GetLiveCount() > 0) {
+        segments_.push_back(std::move(merged));
+    }
+}
+
+void SegmentedSearchServer::MergeLoop() {
+    while (true) {
+        {
+            std::unique_lock lock(merge_mutex_);
+            merge_cv_.wait(lock, [this] { return stopping_ || merge_requested_; });
+            if (stopping_) {
+                return;
+            }
+            merge_requested_ = false;
+            merge_running_ = true;
+        }
+
+        while (true) {
+            std::vector<std::shared_ptr<Segment>> sources;
+            {
+                std::unique_lock lock(index_mutex_);
+                sources = PickMergeCandidates();
+            }
+            if (sources.empty()) {
+                break;
+            }
+            // Само слияние идёт без блокировки: исходные сегменты неизменяемы
+            std::shared_ptr<Segment> merged = MergeSegments(sources);
+            {
+                std::unique_lock lock(index_mutex_);
+                InstallMergedSegment(sources, std::move(merged));
+            }
+        }
+
+        {
+            std::lock_guard lock(merge_mutex_);
+            merge_running_ = false;
+        }
+        merge_cv_.notify_all();
+    }
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+#include "document_filter.h"
+#include "search_server.h"
+#include "string_processing.h"
+
+// Поисковый сервер с сегментированным индексом.
+// Новые документы попадают в небольшой изменяемый сегмент, который по заполнении
+// запечатывается в неизменяемый сегмент с плотной раскладкой списков документов.
+// Удаление из запечатанного сегмента лишь отмечает документ в его битовой маске,
+// а фоновый поток сливает сегменты одного размерного уровня, выбрасывая удалённые документы.
+// Методы можно вызывать из разных потоков одновременно
+class SegmentedSearchServer {
+public:
+    // Кол-во документов в изменяемом сегменте, при котором он запечатывается
+    static constexpr size_t DEFAULT_MUTABLE_SEGMENT_SIZE = 4096;
+    // Сколько сегментов одного размерного уровня сливаются в один
+    static constexpr size_t MERGE_FACTOR = 4;
+
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, size_t mutable_segment_size = DEFAULT_MUTABLE_SEGMENT_SIZE);
+
+    explicit SegmentedSearchServer(const std::string& stop_words_text, size_t mutable_segment_size = DEFAULT_MUTABLE_SEGMENT_SIZE);
+
+    explicit SegmentedSearchServer(std::string_view stop_words_text, size_t mutable_segment_size = DEFAULT_MUTABLE_SEGMENT_SIZE);
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    // Останавливает фоновое слияние
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    // Запрос разбирается, префиксные слова (cat*) раскрываются (не более чем в MAX_PREFIX_EXPANSION_COUNT слов)
+    // и результаты упорядочиваются так же, как в SearchServer. Вместо предиката можно передать фильтр из document_filter.h
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    // Кол-во запечатанных сегментов (без изменяемого)
+    size_t GetSegmentCount() const;
+
+    // Принудительно запечатывает изменяемый сегмент
+    void Seal();
+
+    // Дожидается, пока фоновый поток выполнит все назревшие слияния
+    void WaitForMerges();
+
+private:
+    struct DocumentData {
+        // Строка документа в columns_
+        uint32_t row;
+    };
+
+    struct Posting {
+        // Номер документа внутри сегмента
+        uint32_t ordinal;
+        double term_freq;
+    };
+
+    // Неизменяемый сегмент. Меняется только маска удалённых документов
+    struct Segment {
+        // По возрастанию; позиция в векторе — номер документа внутри сегмента
+        std::vector<int> document_ids;
+        // По возрастанию
+        std::vector<std::string> words;
+        // Документы слова words[i]: postings[word_offsets[i]..word_offsets[i + 1])
+        std::vector<size_t> word_offsets;
+        std::vector<Posting> postings;
+        // Битовая маска удалённых документов
+        std::vector<std::atomic<uint64_t>> tombstones;
+        std::atomic<size_t> removed_count{0};
+
+        explicit Segment(size_t document_count);
+
+        bool IsRemoved(uint32_t ordinal) const;
+        void MarkRemoved(uint32_t ordinal);
+        size_t GetLiveCount() const;
+
+        // Вызывает func(document_id, term_freq) для неудалённых документов слова
+        template <typename Func>
+        void ForEachLivePosting(std::string_view word, Func func) const;
+    };
+
+    struct Query {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+    };
+
+    const std::set<std::string, std::less<>> stop_words_;
+    const size_t mutable_segment_size_;
+
+    // Защищает всё ниже, кроме состояния фонового слияния
+    mutable std::shared_mutex index_mutex_;
+    std::map<int, DocumentData> documents_;
+    // Метаданные документов для фильтров. Строки удалённых документов переиспользуются
+    DocumentColumns columns_;
+    std::vector<uint32_t> free_rows_;
+    std::map<std::string, std::map<int, double>, std::less<>> mutable_segment_;
+    // Документы изменяемого сегмента -> их слова (ссылаются на ключи mutable_segment_)
+    std::map<int, std::vector<std::string_view>> mutable_document_words_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    // Документы, удалённые из сливаемых сегментов во время слияния
+    std::vector<int> removed_during_merge_;
+    bool merge_in_progress_ = false;
+
+    // Состояние фонового слияния
+    std::mutex merge_mutex_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool merge_running_ = false;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+
+    // Вызывает func(document_id, term_freq) для неудалённых документов слова во всех сегментах
+    template <typename Func>
+    void ForEachLivePosting(std::string_view word, Func func) const;
+    // Записывает в word_postings пары (document_id, term_freq) неудалённых документов слова запроса,
+    // по одной на документ. Префикс раскрывается, как в SearchServer: не более MAX_PREFIX_EXPANSION_COUNT
+    // слов, частоты раскрытий в одном документе складываются. Требует блокировки index_mutex_
+    void CollectWordPostings(std::string_view word, std::vector<std::pair<int, double>>& word_postings) const;
+
+    // Требует эксклюзивной блокировки index_mutex_
+    void SealLocked();
+    // Будит фоновый поток слияния; вызывается без блокировки index_mutex_
+    void RequestMerge();
+
+    static std::shared_ptr<Segment> BuildSegment(const std::map<std::string, std::map<int, double>, std::less<>>& word_to_document_freqs,
+                                                 const std::map<int, std::vector<std::string_view>>& document_words);
+    static std::shared_ptr<Segment> MergeSegments(const std::vector<std::shared_ptr<Segment>>& sources);
+    static size_t GetSizeTier(size_t document_count, size_t base_size);
+
+    // Выбирает MERGE_FACTOR сегментов одного уровня; пустой результат — сливать нечего
+    std::vector<std::shared_ptr<Segment>> PickMergeCandidates();
+    void InstallMergedSegment(const std::vector<std::shared_ptr<Segment>>& sources, std::shared_ptr<Segment> merged);
+    void MergeLoop();
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, size_t mutable_segment_size)
+    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , mutable_segment_size_(std::max<size_t>(mutable_segment_size, 1)) {
+    using namespace std::string_literals;
+    if (!std::all_of(stop_words.begin(), stop_words.end(), IsValidWord)) {
+        throw std::invalid_argument("В стоп слове/словах содержатся недопустимые символы"s);
+    }
+    merge_thread_ = std::thread([this] { MergeLoop(); });
+}
+
+template <typename Func>
+void SegmentedSearchServer::Segment::ForEachLivePosting(std::string_view word, Func func) const {
+    const auto found = std::lower_bound(words.begin(), words.end(), word,
+                                        [](const std::string& lhs, std::string_view rhs) { return lhs < rhs; });
+    if (found == words.end() || *found != word) {
+        return;
+    }
+    const size_t word_index = found - words.begin();
+    for (size_t i = word_offsets[word_index]; i < word_offsets[word_index + 1]; ++i) {
+        const Posting& posting = postings[i];
+        if (!IsRemoved(posting.ordinal)) {
+            func(document_ids[posting.ordinal], posting.term_freq);
+        }
+    }
+}
+
+template <typename Func>
+void SegmentedSearchServer::ForEachLivePosting(std::string_view word, Func func) const {
+    for (const auto& segment : segments_) {
+        segment->ForEachLivePosting(word, func);
+    }
+    const auto found = mutable_segment_.find(word);
+    if (found != mutable_segment_.end()) {
+        for (const auto [document_id, term_freq] : found->second) {
+            func(document_id, term_freq);
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const Query query = ParseQuery<Query>(raw_query, stop_words_);
+    const auto filter = MakeDocumentFilter(document_predicate);
+
+    std::shared_lock lock(index_mutex_);
+    std::map<int, double> document_to_relevance;
+    // IDF считается по всем сегментам сразу, поэтому сначала собираем документы слова целиком
+    std::vector<std::pair<int, double>> word_postings;
+
+    for (std::string_view word : query.plus_words) {
+        CollectWordPostings(word, word_postings);
+        if (word_postings.empty()) {
+            continue;
+        }
+        const double inverse_document_freq = std::log(documents_.size() * 1.0 / word_postings.size());
+        for (const auto& [document_id, term_freq] : word_postings) {
+            document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        }
+    }
+
+    for (std::string_view word : query.minus_words) {
+        CollectWordPostings(word, word_postings);
+        for (const auto& [document_id, _] : word_postings) {
+            document_to_relevance.erase(document_id);
+        }
+    }
+
+    // Фильтр вычисляется блоками по строкам столбцов метаданных, как в SearchServer
+    std::vector<Document> matched_documents;
+    uint32_t rows[FILTER_BLOCK_SIZE];
+    char mask[FILTER_BLOCK_SIZE];
+    auto block_begin = document_to_relevance.begin();
+    while (block_begin != document_to_relevance.end()) {
+        auto block_end = block_begin;
+        size_t count = 0;
+        for (; block_end != document_to_relevance.end() && count < FILTER_BLOCK_SIZE; ++block_end) {
+            rows[count++] = documents_.at(block_end->first).row;
+        }
+        filter.EvaluateBlock(columns_, rows, count, mask);
+        for (size_t i = 0; i < count; ++i, ++block_begin) {
+            if (mask[i]) {
+                matched_documents.push_back({block_begin->first, block_begin->second, columns_.ratings[rows[i]]});
+            }
+        }
+    }
+    lock.unlock();
+
+    SortAndTruncate(std::execution::seq, matched_documents);
+    return matched_documents;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Вектор, хранящий первые N элементов внутри себя без обращения к куче.
+// При превышении N элементы переезжают в std::vector
+template <typename T, size_t N>
+class SmallVector {
+public:
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    void push_back(const T& value) {
+        if (heap_data_.empty() && size_ < N) {
+            inline_data_[size_++] = value;
+            return;
+        }
+        if (heap_data_.empty()) {
+            heap_data_.reserve(N * 2);
+            heap_data_.assign(inline_data_.begin(), inline_data_.end());
+        }
+        heap_data_.push_back(value);
+        ++size_;
+    }
+
+    // Удаляет элементы [first, last), сохраняя порядок остальных
+    void erase(iterator first, iterator last) {
+        iterator new_end = std::move(last, end(), first);
+        const size_t new_size = static_cast<size_t>(new_end - begin());
+        if (!heap_data_.empty()) {
+            heap_data_.resize(new_size);
+        }
+        size_ = new_size;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    iterator begin() {
+        return heap_data_.empty() ? inline_data_.data() : heap_data_.data();
+    }
+
+    iterator end() {
+        return begin() + size_;
+    }
+
+    const_iterator begin() const {
+        return heap_data_.empty() ? inline_data_.data() : heap_data_.data();
+    }
+
+    const_iterator end() const {
+        return begin() + size_;
+    }
+
+    T& operator[](size_t index) {
+        return begin()[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return begin()[index];
+    }
+
+private:
+    std::array<T, N> inline_data_{};
+    std::vector<T> heap_data_;
+    size_t size_ = 0;
+};
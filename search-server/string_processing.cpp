@@ -1,20 +1,71 @@
 #include "string_processing.h"
 
+using namespace std::string_literals;
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
-    
-    std::string_view delimiter = " "; 
     std::vector<std::string_view> words;
- 
-    int64_t start_pos = text.find_first_not_of(delimiter);
-    const int64_t end_pos = text.npos;
- 
-    while (start_pos != end_pos) {
-        int64_t space = text.find(' ', start_pos);
-        words.push_back(space == end_pos 
-                        ? text.substr(start_pos)
-                        : text.substr(start_pos, space - start_pos));
-        start_pos = text.find_first_not_of(delimiter, space);
+    ForEachWord(text, [&words](std::string_view word) {
+        words.push_back(word);
+    });
+    return words;
+}
+
+bool IsValidWord(std::string_view word) {
+    return std::none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+    });
+}
+
+std::string ShieldString(std::string_view str) {
+    std::string result = ""s;
+    for (char chr : str) {
+        if (chr >= '\0' && chr < ' ') {
+            continue;
+        }
+        result += chr;
+    }
+    return result;
+}
+
+std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text, const std::set<std::string, std::less<>>& stop_words) {
+    std::vector<std::string_view> words;
+    for (std::string_view word : SplitIntoWords(text)) {
+        if (!IsValidWord(word)) {
+            throw std::invalid_argument(ShieldString("В слове \""s + std::string(word) + "\" присутствуют недопустимые символы"s));
+        }
+        if (!stop_words.count(word)) {
+            words.push_back(word);
+        }
     }
-    
     return words;
-}
\ No newline at end of file
+}
+
+QueryWord ParseQueryWord(std::string_view text, const std::set<std::string, std::less<>>& stop_words) {
+    bool is_minus = false;
+    
+    // Word shouldn't be empty
+    if (text[0] == '-') {
+        is_minus = true;
+        text = text.substr(1);
+    }
+
+    if (!IsValidWord(text)) {
+        throw std::invalid_argument(ShieldString("В слове \""s + std::string(text) + "\" запроса содержатся недопустимые символы"s));
+    }
+
+    if (text.size() == 0 || text[0] == '-') {
+        throw std::invalid_argument("В поисковом запросе присутствуют два знака минуса подряд и/или отсутствуют слова после знака минус"s);
+    }
+
+    // Завершающая '*' делает слово префиксным: cat* совпадает с cat, cats, caterpillar...
+    if (text.back() == '*') {
+        if (text.size() == 1) {
+            throw std::invalid_argument("В поисковом запросе присутствует пустой префикс"s);
+        }
+        const QueryWord query_word = {text, is_minus, false};
+        return query_word;
+    }
+    
+    const QueryWord query_word = {text, is_minus, stop_words.count(text) > 0};
+    return query_word;
+}
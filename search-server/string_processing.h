@@ -1,11 +1,27 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <set>
+#include <stdexcept>
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Вызывает func для каждого слова текста, не создавая промежуточного вектора
+template <typename Func>
+void ForEachWord(std::string_view text, Func func) {
+    size_t start_pos = text.find_first_not_of(' ');
+    while (start_pos != text.npos) {
+        const size_t space = text.find(' ', start_pos);
+        func(space == text.npos 
+             ? text.substr(start_pos)
+             : text.substr(start_pos, space - start_pos));
+        start_pos = text.find_first_not_of(' ', space);
+    }
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -17,4 +33,52 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
         }
     }
     return non_empty_strings;
-}
\ No newline at end of file
+}
+
+// Слово не содержит управляющих символов
+bool IsValidWord(std::string_view word);
+
+// Удаляет вхождения недопустимых символов в строку
+// Необходима для передачи в throw и корректного вывода (иначе на нулевом терминаторе строка обрывается)
+std::string ShieldString(std::string_view str);
+
+// Слова текста без стоп-слов. Для слова с недопустимыми символами бросает std::invalid_argument
+std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text, const std::set<std::string, std::less<>>& stop_words);
+
+struct QueryWord {
+    // Для префиксного слова содержит завершающую '*'
+    std::string_view data;
+    bool is_minus;
+    bool is_stop;
+};
+
+// Проверка слова в поисковом запросе
+QueryWord ParseQueryWord(std::string_view text, const std::set<std::string, std::less<>>& stop_words);
+
+// Проверка поискового запроса: плюс- и минус-слова без стоп-слов, по возрастанию и без повторов.
+// Query — структура с контейнерами plus_words и minus_words
+template <typename Query>
+Query ParseQuery(std::string_view text, const std::set<std::string, std::less<>>& stop_words) {
+    Query query;
+    
+    ForEachWord(text, [&query, &stop_words](std::string_view word) {
+        const QueryWord query_word = ParseQueryWord(word, stop_words);
+        if (!query_word.is_stop) {
+            if (query_word.is_minus) {
+                query.minus_words.push_back(query_word.data);
+            }
+            else {
+                query.plus_words.push_back(query_word.data);
+            }
+        }
+    });
+    
+    // В запросе обычно единицы слов, параллельная сортировка здесь только мешает
+    std::sort(query.minus_words.begin(), query.minus_words.end());
+    std::sort(query.plus_words.begin(), query.plus_words.end());
+        
+    query.minus_words.erase(std::unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
+    query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+    
+    return query;
+}
@@ -0,0 +1,1222 @@
+#include "test_example_functions.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <set>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "async_search_server.h"
+#include "corpus_loader.h"
+#include "process_queries.h"
+#include "segmented_search_server.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// Сколько расхождений сохраняется в отчёт с описанием
+constexpr size_t MAX_REPORTED_MISMATCH_COUNT = 20;
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+std::string GenerateWord(std::mt19937& generator, int dictionary_size) {
+    // Квадрат равномерной величины смещает выбор к началу словаря
+    const double x = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+    return "w"s + std::to_string(static_cast<int>(x * x * dictionary_size));
+}
+
+std::vector<GeneratedDocument> GenerateDocuments(const DifferentialTestConfig& config, std::mt19937& generator) {
+    std::uniform_int_distribution<int> word_count_distribution(1, config.max_document_word_count);
+    std::uniform_int_distribution<int> status_distribution(0, 3);
+    std::uniform_int_distribution<int> rating_distribution(-10, 10);
+
+    std::vector<GeneratedDocument> documents;
+    documents.reserve(config.document_count);
+    for (int i = 0; i < config.document_count; ++i) {
+        GeneratedDocument document;
+        // ID идут с пропусками, чтобы не совпадать с порядковыми номерами
+        document.id = i * 3 + 1;
+        const int word_count = word_count_distribution(generator);
+        for (int j = 0; j < word_count; ++j) {
+            document.text += GenerateWord(generator, config.dictionary_size) + " "s;
+        }
+        document.status = static_cast<DocumentStatus>(status_distribution(generator));
+        document.ratings = {rating_distribution(generator), rating_distribution(generator), rating_distribution(generator)};
+        documents.push_back(std::move(document));
+    }
+    return documents;
+}
+
+std::vector<std::string> GenerateQueries(const DifferentialTestConfig& config, std::mt19937& generator) {
+    std::uniform_int_distribution<int> word_count_distribution(1, config.max_query_word_count);
+    std::bernoulli_distribution is_minus(config.minus_word_probability);
+    std::bernoulli_distribution is_prefix(config.prefix_word_probability);
+
+    std::vector<std::string> queries;
+    queries.reserve(config.query_count);
+    for (int i = 0; i < config.query_count; ++i) {
+        std::string query;
+        const int word_count = word_count_distribution(generator);
+        for (int j = 0; j < word_count; ++j) {
+            std::string word = GenerateWord(generator, config.dictionary_size);
+            if (is_prefix(generator)) {
+                // Префикс из буквы и первой цифры раскрывается в десятки слов
+                word = word.substr(0, 2) + "*"s;
+            }
+            query += (is_minus(generator) ? "-"s : ""s) + word + " "s;
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+void FillServer(SearchServer& search_server, const std::vector<GeneratedDocument>& documents) {
+    for (const GeneratedDocument& document : documents) {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+}
+
+bool AreDocumentsEqual(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id == rhs.id
+            && lhs.rating == rhs.rating
+            && std::abs(lhs.relevance - rhs.relevance) < MIN_COMPARISON_TOLERANCE;
+    });
+}
+
+// nullopt — метод выбросил std::invalid_argument
+template <typename Func>
+std::optional<MatchTuple> TryMatchDocument(Func func) {
+    try {
+        return func();
+    } catch (const std::invalid_argument&) {
+        return std::nullopt;
+    }
+}
+
+template <typename Func>
+double MeasureSeconds(Func func) {
+    const auto start_time = std::chrono::steady_clock::now();
+    func();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void Check(DifferentialTestReport& report, bool is_equal, const std::string& description) {
+    ++report.checked_count;
+    if (is_equal) {
+        return;
+    }
+    ++report.mismatch_count;
+    if (report.mismatches.size() < MAX_REPORTED_MISMATCH_COUNT) {
+        report.mismatches.push_back(description);
+    }
+}
+
+// Кол-во потоков для кривой ускорения: 1, 2, 4, ... и max_thread_count
+std::vector<size_t> GetThreadCounts(size_t max_thread_count) {
+    std::vector<size_t> thread_counts;
+    for (size_t thread_count = 1; thread_count < max_thread_count; thread_count *= 2) {
+        thread_counts.push_back(thread_count);
+    }
+    thread_counts.push_back(std::max<size_t>(max_thread_count, 1));
+    return thread_counts;
+}
+
+void CompareFindTopDocuments(const SearchServer& search_server, ThreadPool& thread_pool,
+                             const std::vector<std::string>& queries, DifferentialTestReport& report) {
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    for (const std::string& query : queries) {
+        const auto seq = search_server.FindTopDocuments(std::execution::seq, query);
+        Check(report, AreDocumentsEqual(seq, search_server.FindTopDocuments(std::execution::par, query)),
+              "FindTopDocuments(par, \""s + query + "\")"s);
+        Check(report, AreDocumentsEqual(seq, search_server.FindTopDocuments(thread_pool, query)),
+              "FindTopDocuments(pool, \""s + query + "\")"s);
+
+        const auto seq_banned = search_server.FindTopDocuments(std::execution::seq, query, DocumentStatus::BANNED);
+        Check(report, AreDocumentsEqual(seq_banned, search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED)),
+              "FindTopDocuments(par, \""s + query + "\", BANNED)"s);
+        Check(report, AreDocumentsEqual(seq_banned, search_server.FindTopDocuments(thread_pool, query, DocumentStatus::BANNED)),
+              "FindTopDocuments(pool, \""s + query + "\", BANNED)"s);
+
+        const auto seq_even = search_server.FindTopDocuments(std::execution::seq, query, is_even);
+        Check(report, AreDocumentsEqual(seq_even, search_server.FindTopDocuments(std::execution::par, query, is_even)),
+              "FindTopDocuments(par, \""s + query + "\", is_even)"s);
+        Check(report, AreDocumentsEqual(seq_even, search_server.FindTopDocuments(thread_pool, query, is_even)),
+              "FindTopDocuments(pool, \""s + query + "\", is_even)"s);
+
+        const PreparedQuery conjunctive_query = search_server.PrepareQuery(query, QueryMode::ALL);
+        const auto seq_all = search_server.FindTopDocuments(std::execution::seq, conjunctive_query);
+        Check(report, AreDocumentsEqual(seq_all, search_server.FindTopDocuments(std::execution::par, conjunctive_query)),
+              "FindTopDocuments(par, \""s + query + "\", ALL)"s);
+        Check(report, AreDocumentsEqual(seq_all, search_server.FindTopDocuments(thread_pool, conjunctive_query)),
+              "FindTopDocuments(pool, \""s + query + "\", ALL)"s);
+    }
+}
+
+void CompareMatchDocument(const SearchServer& search_server, ThreadPool& thread_pool, const std::vector<std::string>& queries,
+                          const std::vector<GeneratedDocument>& documents, std::mt19937& generator, DifferentialTestReport& report) {
+    std::uniform_int_distribution<size_t> document_distribution(0, documents.size() - 1);
+    std::bernoulli_distribution is_invalid_id(0.05);
+    for (const std::string& query : queries) {
+        // Изредка ID заведомо несуществующий: все версии должны одинаково его отвергнуть
+        const int document_id = is_invalid_id(generator) ? -1 : documents[document_distribution(generator)].id;
+        const auto seq = TryMatchDocument([&] { return search_server.MatchDocument(std::execution::seq, query, document_id); });
+        const auto par = TryMatchDocument([&] { return search_server.MatchDocument(std::execution::par, query, document_id); });
+        const auto pool = TryMatchDocument([&] { return search_server.MatchDocument(thread_pool, query, document_id); });
+        const std::string description = "(\""s + query + "\", "s + std::to_string(document_id) + ")"s;
+        Check(report, seq == par, "MatchDocument(par, "s + description);
+        Check(report, seq == pool, "MatchDocument(pool, "s + description);
+    }
+}
+
+void CompareRemoveDocument(const DifferentialTestConfig& config, ThreadPool& thread_pool, const std::vector<GeneratedDocument>& documents,
+                           const std::vector<std::string>& queries, std::mt19937& generator, DifferentialTestReport& report) {
+    // Среди удаляемых ID попадаются и несуществующие
+    std::uniform_int_distribution<int> id_distribution(0, config.document_count * 3);
+    std::set<int> removed_ids;
+    while (removed_ids.size() < static_cast<size_t>(config.removed_document_count)) {
+        removed_ids.insert(id_distribution(generator));
+    }
+
+    SearchServer seq_server("w0 w1"s);
+    SearchServer par_server("w0 w1"s);
+    SearchServer pool_server("w0 w1"s);
+    SearchServer reference_server("w0 w1"s);
+    for (SearchServer* search_server : {&seq_server, &par_server, &pool_server}) {
+        FillServer(*search_server, documents);
+    }
+    for (const GeneratedDocument& document : documents) {
+        if (removed_ids.count(document.id) == 0) {
+            reference_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    }
+    for (const int document_id : removed_ids) {
+        seq_server.RemoveDocument(std::execution::seq, document_id);
+        par_server.RemoveDocument(std::execution::par, document_id);
+        pool_server.RemoveDocument(thread_pool, document_id);
+    }
+
+    // Удалённые документы не должны оставлять следов ни в одном из индексов
+    const std::vector<std::pair<const SearchServer*, std::string>> servers = {
+        {&seq_server, "seq"s}, {&par_server, "par"s}, {&pool_server, "pool"s}};
+    for (const auto& [search_server, name] : servers) {
+        Check(report, search_server->GetDocumentCount() == reference_server.GetDocumentCount(),
+              "RemoveDocument("s + name + "): document count"s);
+        for (const int document_id : removed_ids) {
+            Check(report, search_server->GetWordFrequencies(document_id).empty(),
+                  "RemoveDocument("s + name + ", "s + std::to_string(document_id) + "): word frequencies left"s);
+        }
+        for (const std::string& query : queries) {
+            Check(report, AreDocumentsEqual(reference_server.FindTopDocuments(query), search_server->FindTopDocuments(query)),
+                  "RemoveDocument("s + name + "): FindTopDocuments(\""s + query + "\")"s);
+        }
+    }
+}
+
+void CompareProcessQueries(const SearchServer& search_server, ThreadPool& thread_pool,
+                           const std::vector<std::string>& queries, DifferentialTestReport& report) {
+    std::vector<std::vector<Document>> seq;
+    std::vector<Document> seq_joined;
+    for (const std::string& query : queries) {
+        seq.push_back(search_server.FindTopDocuments(query));
+        seq_joined.insert(seq_joined.end(), seq.back().begin(), seq.back().end());
+    }
+    const auto is_equal = [](const std::vector<std::vector<Document>>& lhs, const std::vector<std::vector<Document>>& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), AreDocumentsEqual);
+    };
+    Check(report, is_equal(seq, ProcessQueries(search_server, queries)), "ProcessQueries(par)"s);
+    Check(report, is_equal(seq, ProcessQueries(thread_pool, search_server, queries)), "ProcessQueries(pool)"s);
+    Check(report, AreDocumentsEqual(seq_joined, ProcessQueriesJoined(search_server, queries)), "ProcessQueriesJoined(par)"s);
+    Check(report, AreDocumentsEqual(seq_joined, ProcessQueriesJoined(thread_pool, search_server, queries)), "ProcessQueriesJoined(pool)"s);
+}
+
+// Замеры ускорения; результаты заодно сверяются с последовательной версией
+void MeasureSpeedup(const DifferentialTestConfig& config, const SearchServer& search_server,
+                    const std::vector<std::string>& queries, DifferentialTestReport& report) {
+    std::vector<std::vector<Document>> seq(queries.size());
+    const double find_seq_seconds = MeasureSeconds([&] {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            seq[i] = search_server.FindTopDocuments(std::execution::seq, queries[i]);
+        }
+    });
+
+    const auto add_point = [&report](const std::string& operation, const std::string& context, size_t thread_count,
+                                     double seconds, double seq_seconds) {
+        report.speedup_curve.push_back({operation, context, thread_count, seconds, seconds > 0 ? seq_seconds / seconds : 0.0});
+    };
+    const auto check_results = [&report, &seq](const std::vector<std::vector<Document>>& results, const std::string& description) {
+        Check(report, std::equal(seq.begin(), seq.end(), results.begin(), results.end(), AreDocumentsEqual), description);
+    };
+
+    const size_t default_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::vector<Document>> results(queries.size());
+    add_point("FindTopDocuments"s, "seq"s, 1, find_seq_seconds, find_seq_seconds);
+    add_point("FindTopDocuments"s, "par"s, default_thread_count, MeasureSeconds([&] {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            results[i] = search_server.FindTopDocuments(std::execution::par, queries[i]);
+        }
+    }), find_seq_seconds);
+    check_results(results, "FindTopDocuments(par): benchmark"s);
+
+    // Параллельность между запросами: последовательная версия та же
+    add_point("ProcessQueries"s, "seq"s, 1, find_seq_seconds, find_seq_seconds);
+    add_point("ProcessQueries"s, "par"s, default_thread_count, MeasureSeconds([&] {
+        results = ProcessQueries(search_server, queries);
+    }), find_seq_seconds);
+    check_results(results, "ProcessQueries(par): benchmark"s);
+
+    for (const size_t thread_count : GetThreadCounts(config.max_thread_count)) {
+        ThreadPool thread_pool(thread_count);
+        const std::string threads = std::to_string(thread_count);
+
+        add_point("FindTopDocuments"s, "pool"s, thread_count, MeasureSeconds([&] {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                results[i] = search_server.FindTopDocuments(thread_pool, queries[i]);
+            }
+        }), find_seq_seconds);
+        check_results(results, "FindTopDocuments(pool, "s + threads + "): benchmark"s);
+
+        add_point("ProcessQueries"s, "pool"s, thread_count, MeasureSeconds([&] {
+            results = ProcessQueries(thread_pool, search_server, queries);
+        }), find_seq_seconds);
+        check_results(results, "ProcessQueries(pool, "s + threads + "): benchmark"s);
+    }
+}
+
+// Бросает std::logic_error с описанием проверки, если условие не выполнено
+void CheckTest(bool condition, const std::string& description) {
+    if (!condition) {
+        throw std::logic_error("Тест не пройден: "s + description);
+    }
+}
+
+std::vector<int> GetDocumentIds(const std::vector<Document>& documents) {
+    std::vector<int> ids;
+    ids.reserve(documents.size());
+    for (const Document& document : documents) {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+// Файл во временном каталоге, удаляется вместе с объектом
+class TemporaryFile {
+public:
+    explicit TemporaryFile(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() / name).string()) {
+        std::filesystem::remove(path_);
+    }
+
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile() {
+        std::error_code error;
+        std::filesystem::remove(path_, error);
+    }
+
+    const std::string& GetPath() const {
+        return path_;
+    }
+
+private:
+    std::string path_;
+};
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+}
+
+void WriteFile(const std::string& path, std::string_view data) {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// Небольшой случайный корпус и запросы к нему для проверок поведения
+std::vector<GeneratedDocument> GenerateTestDocuments(int document_count, uint32_t seed) {
+    DifferentialTestConfig config;
+    config.document_count = document_count;
+    config.dictionary_size = 300;
+    config.max_document_word_count = 20;
+    std::mt19937 generator(seed);
+    return GenerateDocuments(config, generator);
+}
+
+std::vector<std::string> GenerateTestQueries(int query_count, uint32_t seed, double prefix_word_probability = 0.0) {
+    DifferentialTestConfig config;
+    config.dictionary_size = 300;
+    config.query_count = query_count;
+    config.max_query_word_count = 4;
+    config.prefix_word_probability = prefix_word_probability;
+    std::mt19937 generator(seed);
+    return GenerateQueries(config, generator);
+}
+
+// Принимает документы с любым статусом
+bool AcceptAnyDocument(int, DocumentStatus, int) {
+    return true;
+}
+
+} // namespace
+
+DifferentialTestReport RunDifferentialTest(const DifferentialTestConfig& config) {
+    if (config.document_count <= 0 || config.dictionary_size <= 0 || config.max_document_word_count <= 0
+        || config.max_query_word_count <= 0 || config.removed_document_count > config.document_count * 3) {
+        throw std::invalid_argument("Некорректные параметры сравнения версий"s);
+    }
+
+    DifferentialTestReport report;
+    std::mt19937 generator(config.seed);
+    const std::vector<GeneratedDocument> documents = GenerateDocuments(config, generator);
+    const std::vector<std::string> queries = GenerateQueries(config, generator);
+
+    SearchServer search_server("w0 w1"s);
+    FillServer(search_server, documents);
+    ThreadPool thread_pool(config.max_thread_count);
+
+    CompareFindTopDocuments(search_server, thread_pool, queries, report);
+    CompareMatchDocument(search_server, thread_pool, queries, documents, generator, report);
+    CompareProcessQueries(search_server, thread_pool, queries, report);
+    CompareRemoveDocument(config, thread_pool, documents, queries, generator, report);
+    if (config.measure_speedup) {
+        MeasureSpeedup(config, search_server, queries, report);
+    }
+
+    return report;
+}
+
+void PrintDifferentialTestReport(const DifferentialTestReport& report, std::ostream& out) {
+    out << "Checks: "s << report.checked_count << ", mismatches: "s << report.mismatch_count << std::endl;
+    for (const std::string& mismatch : report.mismatches) {
+        out << "  "s << mismatch << std::endl;
+    }
+    if (report.speedup_curve.empty()) {
+        return;
+    }
+
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::left << std::setw(20) << "operation"s << std::setw(8) << "context"s
+        << std::setw(8) << "threads"s << std::setw(12) << "seconds"s << "speedup"s << std::endl;
+    for (const SpeedupPoint& point : report.speedup_curve) {
+        out << std::left << std::setw(20) << point.operation << std::setw(8) << point.context
+            << std::setw(8) << point.thread_count << std::setw(12) << std::fixed << std::setprecision(4) << point.seconds
+            << std::setprecision(2) << point.speedup << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void TestParallelVersionsMatchSequential(const DifferentialTestConfig& config) {
+    const DifferentialTestReport report = RunDifferentialTest(config);
+    if (report.mismatch_count > 0) {
+        throw std::logic_error("Параллельные версии расходятся с последовательными: "s
+                               + std::to_string(report.mismatch_count) + " из "s + std::to_string(report.checked_count)
+                               + ", первое — "s + report.mismatches.front());
+    }
+}
+
+void TestDeadlineSearch() {
+    using namespace std::chrono_literals;
+    SearchServer search_server("w0"s);
+    FillServer(search_server, GenerateTestDocuments(2000, 1));
+
+    for (const std::string& query : GenerateTestQueries(50, 2, 0.05)) {
+        for (QueryMode mode : {QueryMode::ANY, QueryMode::ALL}) {
+            const std::string description = "\""s + query + (mode == QueryMode::ALL ? "\", ALL"s : "\", ANY"s);
+
+            const DeadlineSearchResult expired = search_server.FindTopDocumentsWithDeadline(
+                query, DocumentStatus::ACTUAL, SearchClock::now() - 1s, mode);
+            CheckTest(expired.truncated && expired.documents.empty(),
+                      "истёкший дедлайн прерывает поиск до ранжирования: "s + description);
+
+            const DeadlineSearchResult completed = search_server.FindTopDocumentsWithDeadline(
+                query, DocumentStatus::ACTUAL, SearchClock::now() + 1h, mode);
+            CheckTest(!completed.truncated
+                          && AreDocumentsEqual(completed.documents, search_server.FindTopDocuments(search_server.PrepareQuery(query, mode))),
+                      "поиск без истёкшего дедлайна совпадает с обычным: "s + description);
+        }
+    }
+}
+
+void TestAsyncSearchServer() {
+    using namespace std::chrono_literals;
+    SearchServer search_server("w0"s);
+    FillServer(search_server, GenerateTestDocuments(500, 3));
+    const std::string query = "w1 w2 w3"s;
+
+    AsyncSearchServer async_server(search_server, 1, 1);
+
+    // Единственный рабочий поток занят первым запросом, пока не открыт шлюз
+    std::promise<void> gate;
+    const std::shared_future<void> gate_opened = gate.get_future().share();
+    std::future<DeadlineSearchResult> blocked = async_server.FindTopDocuments(query, [gate_opened](int, DocumentStatus, int) {
+            gate_opened.wait();
+            return true;
+        }, 1h);
+    while (async_server.GetQueueSize() > 0) {
+        std::this_thread::yield();
+    }
+    std::future<DeadlineSearchResult> queued = async_server.FindTopDocuments(query, 1h);
+    bool is_rejected = false;
+    try {
+        async_server.FindTopDocuments(query, 1h);
+    } catch (const std::runtime_error&) {
+        is_rejected = true;
+    }
+    const size_t rejected_count = async_server.GetRejectedCount();
+    // Шлюз открывается до проверок, иначе деструктор сервера ждал бы рабочий поток вечно
+    gate.set_value();
+
+    CheckTest(is_rejected && rejected_count == 1, "запрос сверх размера очереди отклоняется"s);
+    CheckTest(AreDocumentsEqual(blocked.get().documents, search_server.FindTopDocuments(query, AcceptAnyDocument)),
+              "асинхронный поиск с предикатом совпадает с синхронным"s);
+    CheckTest(AreDocumentsEqual(queued.get().documents, search_server.FindTopDocuments(query)),
+              "запрос из очереди совпадает с синхронным"s);
+
+    const DeadlineSearchResult expired = async_server.FindTopDocuments(query, 0ms).get();
+    CheckTest(expired.truncated && expired.documents.empty(), "запрос с дедлайном, истёкшим в очереди, не ранжируется"s);
+
+    const DeadlineSearchResult conjunctive = async_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 1h, QueryMode::ALL).get();
+    CheckTest(AreDocumentsEqual(conjunctive.documents, search_server.FindTopDocuments(search_server.PrepareQuery(query, QueryMode::ALL))),
+              "асинхронный поиск в режиме ALL совпадает с синхронным"s);
+
+    const int document_id = *search_server.begin();
+    CheckTest(async_server.MatchDocument(query, document_id).get() == search_server.MatchDocument(query, document_id),
+              "асинхронный MatchDocument совпадает с синхронным"s);
+}
+
+void TestLoadCorpus() {
+    static const char* const STATUS_NAMES[] = {"ACTUAL", "IRRELEVANT", "BANNED", "REMOVED"};
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(300, 4);
+    TemporaryFile corpus_file("search_server_test_corpus.tsv"s);
+    {
+        std::ofstream output(corpus_file.GetPath());
+        for (const GeneratedDocument& document : documents) {
+            output << document.id << '\t' << STATUS_NAMES[static_cast<int>(document.status)] << '\t';
+            for (size_t i = 0; i < document.ratings.size(); ++i) {
+                output << (i > 0 ? " "s : ""s) << document.ratings[i];
+            }
+            // Пустые строки между записями пропускаются
+            output << '\t' << document.text << "\n\n"s;
+        }
+    }
+
+    SearchServer reference_server("w0"s);
+    FillServer(reference_server, documents);
+    SearchServer loaded_server("w0"s);
+    LoadCorpus(loaded_server, corpus_file.GetPath(), 2);
+    ThreadPool thread_pool(2);
+    SearchServer pool_loaded_server("w0"s);
+    pool_loaded_server.SetTextStorage(TextStorageMode::DISCARD);
+    LoadCorpus(pool_loaded_server, corpus_file.GetPath(), thread_pool);
+
+    CheckTest(loaded_server.GetDocumentCount() == reference_server.GetDocumentCount()
+                  && pool_loaded_server.GetDocumentCount() == reference_server.GetDocumentCount(),
+              "загружаются все документы корпуса"s);
+    for (const GeneratedDocument& document : documents) {
+        CheckTest(loaded_server.GetDocumentText(document.id) == document.text, "текст загруженного документа не искажается"s);
+    }
+    for (const std::string& query : GenerateTestQueries(50, 5, 0.05)) {
+        const auto expected = reference_server.FindTopDocuments(query, AcceptAnyDocument);
+        CheckTest(AreDocumentsEqual(loaded_server.FindTopDocuments(query, AcceptAnyDocument), expected)
+                      && AreDocumentsEqual(pool_loaded_server.FindTopDocuments(query, AcceptAnyDocument), expected),
+                  "поиск по загруженному корпусу совпадает с поиском по добавленным документам: "s + query);
+    }
+
+    for (const std::string& bad_corpus : {"1\tACTUAL\t1 2\n"s, "1\tUNKNOWN\t1\tw1 w2\n"s, "x\tACTUAL\t1\tw1 w2\n"s}) {
+        WriteFile(corpus_file.GetPath(), bad_corpus);
+        SearchServer search_server("w0"s);
+        bool is_rejected = false;
+        try {
+            LoadCorpus(search_server, corpus_file.GetPath(), thread_pool);
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        CheckTest(is_rejected, "некорректная запись корпуса отвергается"s);
+    }
+
+    std::string error_message;
+    try {
+        ParseCorpus("1\tACTUAL\t1\tw1\n\n2\tACTUAL\t1\tw2\n3\tUNKNOWN\t1\tw3\n"s, thread_pool);
+    } catch (const std::invalid_argument& error) {
+        error_message = error.what();
+    }
+    CheckTest(error_message.find("строке 4 "s) != std::string::npos && error_message.find("байт 29"s) != std::string::npos,
+              "ошибка разбора корпуса указывает строку и смещение записи"s);
+}
+
+void TestAddDocumentsBatch() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    auto texts = std::make_shared<std::vector<std::string>>(std::vector<std::string>{"black dog"s, "curly cat"s, "bad\x01word"s});
+    const std::vector<DocumentRecord> duplicate_in_batch = {{10, DocumentStatus::ACTUAL, {1}, (*texts)[0]},
+                                                            {11, DocumentStatus::ACTUAL, {2}, (*texts)[1]},
+                                                            {10, DocumentStatus::ACTUAL, {3}, (*texts)[1]}};
+    const std::vector<DocumentRecord> existing_id = {{10, DocumentStatus::ACTUAL, {1}, (*texts)[0]},
+                                                     {1, DocumentStatus::ACTUAL, {2}, (*texts)[1]}};
+    const std::vector<DocumentRecord> invalid_text = {{10, DocumentStatus::ACTUAL, {1}, (*texts)[0]},
+                                                      {11, DocumentStatus::ACTUAL, {2}, (*texts)[2]}};
+    ThreadPool thread_pool(2);
+
+    for (const std::vector<DocumentRecord>* records : {&duplicate_in_batch, &existing_id, &invalid_text}) {
+        for (bool use_thread_pool : {false, true}) {
+            bool is_rejected = false;
+            try {
+                if (use_thread_pool) {
+                    search_server.AddDocuments(thread_pool, texts, *records);
+                } else {
+                    search_server.AddDocuments(texts, *records);
+                }
+            } catch (const std::invalid_argument&) {
+                is_rejected = true;
+            }
+            bool is_text_missing = false;
+            try {
+                search_server.GetDocumentText(10);
+            } catch (const std::invalid_argument&) {
+                is_text_missing = true;
+            }
+            CheckTest(is_rejected && is_text_missing && search_server.GetDocumentCount() == 1
+                          && search_server.FindTopDocuments("dog"s).empty() && search_server.GetDocumentText(1) == "white cat"s,
+                      "отвергнутая пачка не добавляет ни одного документа"s);
+        }
+    }
+
+    search_server.AddDocuments(texts, {{10, DocumentStatus::ACTUAL, {1}, (*texts)[0]}, {11, DocumentStatus::ACTUAL, {2}, (*texts)[1]}});
+    CheckTest(search_server.GetDocumentCount() == 3 && search_server.GetDocumentText(11) == "curly cat"s,
+              "после отвергнутых пачек корректная пачка добавляется"s);
+}
+
+void TestPrefixQuery() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(2, "category list"s, DocumentStatus::ACTUAL, {3});
+    search_server.AddDocument(3, "cattle farm"s, DocumentStatus::ACTUAL, {2});
+    search_server.AddDocument(4, "dog house"s, DocumentStatus::ACTUAL, {4});
+    search_server.AddDocument(5, "cap"s, DocumentStatus::ACTUAL, {0});
+
+    // Раскрытия префикса считаются одним словом запроса, поэтому IDF у документов общий,
+    // а при равной релевантности порядок решает рейтинг
+    CheckTest(GetDocumentIds(search_server.FindTopDocuments("cat*"s)) == std::vector<int>{2, 3, 1}, "cat* находит cat, category и cattle"s);
+    CheckTest(GetDocumentIds(search_server.FindTopDocuments("cat* -farm"s)) == std::vector<int>{2, 1}, "минус-слово исключает документ из раскрытия префикса"s);
+    CheckTest(GetDocumentIds(search_server.FindTopDocuments("ca*"s)) == std::vector<int>{5, 2, 3, 1}, "ca* находит и cap"s);
+    CheckTest(search_server.FindTopDocuments("cow*"s).empty(), "префикс без раскрытий ничего не находит"s);
+
+    const auto [words, status] = search_server.MatchDocument("cat* dog"s, 1);
+    CheckTest(words == std::vector<std::string_view>{"cat", "dog"} && status == DocumentStatus::ACTUAL,
+              "MatchDocument возвращает раскрытия префикса, совпавшие с документом"s);
+    CheckTest(std::get<0>(search_server.MatchDocument("cat*"s, 2)) == std::vector<std::string_view>{"category"},
+              "MatchDocument возвращает слово документа, а не префикс"s);
+    CheckTest(std::get<0>(search_server.MatchDocument("cat* -dog"s, 1)).empty(), "минус-слово отменяет совпадение по префиксу"s);
+    CheckTest(std::get<0>(search_server.MatchDocument("cat*"s, 4)).empty(), "префикс не совпадает с документом без раскрытий"s);
+
+    // Раскрытия сверх MAX_PREFIX_EXPANSION_COUNT отбрасываются: совпадают только первые по алфавиту слова
+    SearchServer capped_server(""s);
+    for (int i = 0; i <= MAX_PREFIX_EXPANSION_COUNT; ++i) {
+        const std::string number = std::to_string(i);
+        capped_server.AddDocument(i, "p"s + std::string(3 - number.size(), '0') + number, DocumentStatus::ACTUAL, {1});
+    }
+    CheckTest(std::get<0>(capped_server.MatchDocument("p*"s, MAX_PREFIX_EXPANSION_COUNT - 1)).size() == 1
+                  && std::get<0>(capped_server.MatchDocument("p*"s, MAX_PREFIX_EXPANSION_COUNT)).empty(),
+              "префикс раскрывается не более чем в MAX_PREFIX_EXPANSION_COUNT слов"s);
+}
+
+void TestCompact() {
+    SearchServer search_server("w0"s);
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(2000, 6);
+    FillServer(search_server, documents);
+    std::map<int, int64_t> times;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (i % 5 == 0) {
+            search_server.RemoveDocument(documents[i].id);
+        } else if (i % 2 == 0) {
+            times[documents[i].id] = static_cast<int64_t>(i % 1000);
+            search_server.SetDocumentAttribute(documents[i].id, "time"s, times[documents[i].id]);
+        }
+    }
+
+    const std::vector<std::string> queries = GenerateTestQueries(100, 7, 0.05);
+    const auto filter = AttributeBetween("time"s, 100, 600) && !StatusEquals(DocumentStatus::BANNED);
+    const auto search = [&] {
+        std::vector<std::vector<Document>> results;
+        for (const std::string& query : queries) {
+            results.push_back(search_server.FindTopDocuments(query, AcceptAnyDocument));
+            results.push_back(search_server.FindTopDocuments(query, filter));
+            results.push_back(search_server.FindTopDocuments(search_server.PrepareQuery(query, QueryMode::ALL)));
+        }
+        return results;
+    };
+    const std::vector<std::vector<Document>> expected = search();
+    const int document_count = search_server.GetDocumentCount();
+    const size_t memory_before = search_server.GetMemoryUsage().GetTotal();
+
+    search_server.Compact();
+
+    CheckTest(search_server.GetDocumentCount() == document_count, "Compact не меняет кол-во документов"s);
+    CheckTest(search_server.GetMemoryUsage().GetTotal() < memory_before, "Compact освобождает память удалённых документов"s);
+    const std::vector<std::vector<Document>> compacted = search();
+    CheckTest(std::equal(expected.begin(), expected.end(), compacted.begin(), compacted.end(), AreDocumentsEqual),
+              "Compact не меняет результаты поиска"s);
+    for (const auto& [document_id, time] : times) {
+        CheckTest(search_server.GetDocumentAttribute(document_id, "time"s) == time, "Compact сохраняет атрибуты документов"s);
+    }
+
+    search_server.AddDocument(100000, "w1 w2"s, DocumentStatus::ACTUAL, {5});
+    CheckTest(search_server.GetDocumentAttribute(100000, "time"s) == 0
+                  && search_server.FindTopDocuments("w1 w2"s, AttributeBetween("time"s, 0, 0) && IdInRange(100000, 100000)).size() == 1,
+              "после Compact документы добавляются с незаданными атрибутами"s);
+}
+
+void TestSegmentedSearchServer() {
+    SegmentedSearchServer segmented_server("w0"s, 16);
+    SearchServer reference_server("w0"s);
+    std::vector<GeneratedDocument> documents = GenerateTestDocuments(1000, 8);
+    // Одинаковые тексты дают равную релевантность: порядок решают рейтинг, затем ID
+    for (int i = 0; i < 20; ++i) {
+        documents.push_back({5000 + (i * 7) % 20, "w1 w2 tie"s, DocumentStatus::ACTUAL, {i % 3}});
+    }
+    for (const GeneratedDocument& document : documents) {
+        segmented_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        reference_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+
+    // Часть слов запросов префиксные: раскрытие должно идти по всем сегментам сразу
+    const std::vector<std::string> queries = GenerateTestQueries(100, 9, 0.3);
+    const auto check_results = [&](const std::string& stage) {
+        CheckTest(segmented_server.GetDocumentCount() == reference_server.GetDocumentCount(),
+                  "кол-во документов совпадает с SearchServer "s + stage);
+        const auto is_even = [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 0;
+        };
+        const auto filter = StatusEquals(DocumentStatus::ACTUAL) && RatingBetween(0, 5);
+        for (const std::string& query : queries) {
+            CheckTest(AreDocumentsEqual(segmented_server.FindTopDocuments(query), reference_server.FindTopDocuments(query))
+                          && AreDocumentsEqual(segmented_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                                               reference_server.FindTopDocuments(query, DocumentStatus::BANNED))
+                          && AreDocumentsEqual(segmented_server.FindTopDocuments(query, is_even), reference_server.FindTopDocuments(query, is_even))
+                          && AreDocumentsEqual(segmented_server.FindTopDocuments(query, filter), reference_server.FindTopDocuments(query, filter)),
+                      "результаты совпадают с SearchServer "s + stage + ": "s + query);
+        }
+        CheckTest(AreDocumentsEqual(segmented_server.FindTopDocuments("tie"s), reference_server.FindTopDocuments("tie"s)),
+                  "равная релевантность упорядочивается как в SearchServer "s + stage);
+    };
+
+    check_results("после добавления"s);
+
+    // Удаления попадают и в запечатанные сегменты, и в изменяемый
+    for (size_t i = 0; i < documents.size(); i += 4) {
+        segmented_server.RemoveDocument(documents[i].id);
+        reference_server.RemoveDocument(documents[i].id);
+    }
+    check_results("после удаления"s);
+
+    segmented_server.Seal();
+    segmented_server.WaitForMerges();
+    CheckTest(segmented_server.GetSegmentCount() < documents.size() / 16, "сегменты одного уровня сливаются"s);
+    check_results("после слияния"s);
+
+    for (size_t i = 1; i < documents.size(); i += 3) {
+        segmented_server.RemoveDocument(documents[i].id);
+        reference_server.RemoveDocument(documents[i].id);
+    }
+    check_results("после удаления из слитых сегментов"s);
+
+    // Повторно добавленные документы занимают освободившиеся строки метаданных
+    for (size_t i = 0; i < documents.size(); i += 8) {
+        segmented_server.AddDocument(documents[i].id, documents[i].text, DocumentStatus::BANNED, {7});
+        reference_server.AddDocument(documents[i].id, documents[i].text, DocumentStatus::BANNED, {7});
+    }
+    check_results("после повторного добавления"s);
+}
+
+void TestDocumentTextStore() {
+    TemporaryFile store_file("search_server_test_texts.bin"s);
+    constexpr size_t BLOCK_SIZE = 64;
+    constexpr size_t CACHE_BLOCK_COUNT = 2;
+    DocumentTextStore text_store(store_file.GetPath(), BLOCK_SIZE, CACHE_BLOCK_COUNT);
+
+    // Тексты пустые, короче блока, на границе блоков и длиннее нескольких блоков
+    std::vector<std::string> texts = {""s, "short"s, std::string(BLOCK_SIZE - 5, 'a'), std::string(BLOCK_SIZE * 3 + 7, 'b')};
+    for (const GeneratedDocument& document : GenerateTestDocuments(200, 10)) {
+        texts.push_back(document.text);
+    }
+    std::vector<DocumentTextStore::Location> locations;
+    for (const std::string& text : texts) {
+        locations.push_back(text_store.Append(text));
+    }
+
+    for (size_t i = texts.size(); i-- > 0;) {
+        CheckTest(text_store.Read(locations[i]) == texts[i], "текст читается из хранилища без искажений"s);
+    }
+    // Кэш уже заполнен, и дальнейшие чтения только вытесняют из него блоки
+    const size_t memory_usage = text_store.GetMemoryUsage();
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<size_t> text_distribution(0, texts.size() - 1);
+    for (int i = 0; i < 500; ++i) {
+        const size_t text_index = text_distribution(generator);
+        CheckTest(text_store.Read(locations[text_index]) == texts[text_index], "текст читается в произвольном порядке"s);
+    }
+    CheckTest(text_store.GetMemoryUsage() == memory_usage, "кэш хранилища не растёт сверх заданного кол-ва блоков"s);
+
+    SearchServer search_server("w0"s);
+    search_server.SetTextStorage(TextStorageMode::EXTERNAL_FILE, std::make_shared<DocumentTextStore>(store_file.GetPath(), BLOCK_SIZE));
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(200, 12);
+    FillServer(search_server, documents);
+    for (size_t i = 0; i < documents.size(); i += 2) {
+        search_server.RemoveDocument(documents[i].id);
+    }
+    search_server.Compact();
+    for (size_t i = 1; i < documents.size(); i += 2) {
+        CheckTest(search_server.GetDocumentText(documents[i].id) == documents[i].text, "сервер читает тексты из файлового хранилища"s);
+    }
+}
+
+void TestDocumentFilters() {
+    SearchServer search_server("w0"s);
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(1500, 13);
+    FillServer(search_server, documents);
+    std::map<int, int64_t> times;
+    for (size_t i = 0; i < documents.size(); i += 2) {
+        times[documents[i].id] = static_cast<int64_t>(i % 1000);
+        search_server.SetDocumentAttribute(documents[i].id, "time"s, times[documents[i].id]);
+    }
+    ThreadPool thread_pool(2);
+
+    const auto rating_filter = StatusEquals(DocumentStatus::ACTUAL) && RatingBetween(-3, 5);
+    const auto rating_predicate = [](int, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL && rating >= -3 && rating <= 5;
+    };
+    const auto id_filter = IdIsEven() || !IdInRange(100, 3000);
+    const auto id_predicate = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0 || document_id < 100 || document_id > 3000;
+    };
+    const auto attribute_filter = AttributeBetween("time"s, 100, 600) && StatusEquals(DocumentStatus::BANNED);
+    const auto attribute_predicate = [&times](int document_id, DocumentStatus status, int) {
+        const auto time = times.find(document_id);
+        const int64_t value = time == times.end() ? 0 : time->second;
+        return status == DocumentStatus::BANNED && value >= 100 && value <= 600;
+    };
+
+    for (const std::string& query : GenerateTestQueries(50, 14, 0.05)) {
+        for (QueryMode mode : {QueryMode::ANY, QueryMode::ALL}) {
+            const PreparedQuery prepared_query = search_server.PrepareQuery(query, mode);
+            const auto check_filter = [&](const auto& filter, const auto& predicate, const std::string& name) {
+                const auto expected = search_server.FindTopDocuments(prepared_query, PredicateFilter(predicate));
+                CheckTest(AreDocumentsEqual(search_server.FindTopDocuments(prepared_query, filter), expected)
+                              && AreDocumentsEqual(search_server.FindTopDocuments(std::execution::par, prepared_query, filter), expected)
+                              && AreDocumentsEqual(search_server.FindTopDocuments(thread_pool, prepared_query, filter), expected),
+                          "фильтр "s + name + " совпадает с предикатом: "s + query);
+            };
+            check_filter(rating_filter, rating_predicate, "StatusEquals && RatingBetween"s);
+            check_filter(id_filter, id_predicate, "IdIsEven || !IdInRange"s);
+            check_filter(attribute_filter, attribute_predicate, "AttributeBetween && StatusEquals"s);
+            check_filter(AttributeBetween("missing"s, -1, 1), AcceptAnyDocument, "AttributeBetween по незаданному атрибуту"s);
+        }
+    }
+}
+
+void TestIndexLog() {
+    TemporaryFile log_file("search_server_test_index.log"s);
+    TemporaryFile torn_log_file("search_server_test_torn_index.log"s);
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(600, 15);
+
+    SearchServer original_server("w0"s);
+    auto index_log = std::make_shared<IndexLog>(log_file.GetPath());
+    original_server.SetIndexLog(index_log);
+    // Половина документов добавляется по одному, половина — пачкой
+    auto texts = std::make_shared<std::vector<std::string>>();
+    std::vector<DocumentRecord> records;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const GeneratedDocument& document = documents[i];
+        if (i < documents.size() / 2) {
+            original_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        } else {
+            texts->push_back(document.text);
+        }
+    }
+    for (size_t i = documents.size() / 2; i < documents.size(); ++i) {
+        const GeneratedDocument& document = documents[i];
+        records.push_back({document.id, document.status, document.ratings, (*texts)[i - documents.size() / 2]});
+    }
+    original_server.AddDocuments(texts, records);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        if (i % 7 == 0) {
+            original_server.RemoveDocument(documents[i].id);
+        } else if (i % 3 == 0) {
+            original_server.SetDocumentAttribute(documents[i].id, "time"s, static_cast<int64_t>(i));
+        }
+    }
+    index_log->Flush();
+    const uint64_t last_sequence = index_log->GetLastSequence();
+    CheckTest(index_log->GetDurableSequence() == last_sequence, "после Flush все записи журнала на диске"s);
+
+    const std::vector<std::string> queries = GenerateTestQueries(50, 16, 0.05);
+    const auto search = [&queries](const SearchServer& search_server) {
+        std::vector<std::vector<Document>> results;
+        for (const std::string& query : queries) {
+            results.push_back(search_server.FindTopDocuments(query, AcceptAnyDocument));
+            results.push_back(search_server.FindTopDocuments(query, AttributeBetween("time"s, 100, 400)));
+        }
+        return results;
+    };
+    const auto are_results_equal = [](const std::vector<std::vector<Document>>& lhs, const std::vector<std::vector<Document>>& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), AreDocumentsEqual);
+    };
+    const std::vector<std::vector<Document>> expected = search(original_server);
+    ThreadPool thread_pool(2);
+
+    SearchServer replayed_server("w0"s);
+    CheckTest(ReplayIndexLog(replayed_server, log_file.GetPath(), 0, thread_pool) == last_sequence
+                  && replayed_server.GetDocumentCount() == original_server.GetDocumentCount()
+                  && are_results_equal(search(replayed_server), expected),
+              "воспроизведение журнала восстанавливает сервер"s);
+
+    // Журнал, оборванный посреди записи, как после аварийного завершения
+    const std::string data = ReadFile(log_file.GetPath());
+    WriteFile(torn_log_file.GetPath(), std::string_view(data).substr(0, data.size() * 6 / 10));
+    SearchServer resumed_server("w0"s);
+    const uint64_t torn_sequence = ReplayIndexLog(resumed_server, torn_log_file.GetPath(), 0, thread_pool);
+    CheckTest(torn_sequence > 0 && torn_sequence < last_sequence, "из оборванного журнала применяются только целые записи"s);
+    CheckTest(ReplayIndexLog(resumed_server, log_file.GetPath(), torn_sequence, thread_pool) == last_sequence
+                  && are_results_equal(search(resumed_server), expected),
+              "остаток журнала применяется поверх уже применённых записей"s);
+
+    {
+        IndexLog reopened_log(torn_log_file.GetPath());
+        CheckTest(reopened_log.GetLastSequence() == torn_sequence, "номера записей продолжаются после переоткрытия журнала"s);
+        reopened_log.WaitDurable(reopened_log.AppendRemoveDocument(documents[1].id));
+    }
+    const std::string reopened_data = ReadFile(torn_log_file.GetPath());
+    size_t valid_size = 0;
+    const std::vector<IndexLogEntry> appended = ParseIndexLog(reopened_data, torn_sequence, &valid_size);
+    CheckTest(valid_size == reopened_data.size() && appended.size() == 1 && appended[0].sequence == torn_sequence + 1
+                  && appended[0].operation == IndexLogOperation::REMOVE_DOCUMENT && appended[0].document_id == documents[1].id,
+              "недописанный хвост отбрасывается, новые записи идут сразу за целыми"s);
+
+    std::string corrupted_data = data;
+    corrupted_data[corrupted_data.size() / 2] ^= 0x55;
+    const std::vector<IndexLogEntry> entries = ParseIndexLog(corrupted_data, 0, &valid_size);
+    CheckTest(!entries.empty() && valid_size <= corrupted_data.size() / 2 && entries.back().sequence == entries.size(),
+              "разбор журнала останавливается на записи с неверной контрольной суммой"s);
+
+    // Вторая пачка добавлений конфликтует с документом, который уже есть в сервере
+    TemporaryFile conflict_log_file("search_server_test_conflict_index.log"s);
+    {
+        IndexLog conflict_log(conflict_log_file.GetPath());
+        conflict_log.AppendAddDocument(1, DocumentStatus::ACTUAL, {1}, "white cat"s);
+        conflict_log.AppendAddDocument(2, DocumentStatus::ACTUAL, {2}, "black dog"s);
+        conflict_log.AppendRemoveDocument(1);
+        conflict_log.AppendAddDocument(3, DocumentStatus::ACTUAL, {3}, "curly cat"s);
+        conflict_log.WaitDurable(conflict_log.AppendAddDocument(4, DocumentStatus::ACTUAL, {4}, "nasty dog"s));
+    }
+    SearchServer conflict_server("w0"s);
+    conflict_server.AddDocument(4, "old text"s, DocumentStatus::ACTUAL, {0});
+    uint64_t last_applied_sequence = 0;
+    try {
+        ReplayIndexLog(conflict_server, conflict_log_file.GetPath(), 0, thread_pool);
+    } catch (const IndexLogReplayError& error) {
+        last_applied_sequence = error.GetLastAppliedSequence();
+    }
+    CheckTest(last_applied_sequence == 3 && conflict_server.GetDocumentCount() == 2 && conflict_server.FindTopDocuments("curly"s).empty(),
+              "ошибка воспроизведения сообщает номер последней применённой записи"s);
+    conflict_server.RemoveDocument(4);
+    CheckTest(ReplayIndexLog(conflict_server, conflict_log_file.GetPath(), last_applied_sequence, thread_pool) == 5
+                  && GetDocumentIds(conflict_server.FindTopDocuments("cat dog"s)).size() == 3
+                  && conflict_server.GetDocumentText(4) == "nasty dog"s,
+              "воспроизведение продолжается с последней применённой записи"s);
+}
+
+void TestConjunctiveQueryMode() {
+    // Без стоп-слов: эталон разбирает тексты сам и не должен знать о них
+    SearchServer search_server(""s);
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(3000, 17);
+    FillServer(search_server, documents);
+    const double document_count = static_cast<double>(documents.size());
+
+    // Эталон: частоты слов каждого документа, посчитанные прямо по тексту
+    std::vector<std::map<std::string, double>> document_word_freqs;
+    for (const GeneratedDocument& document : documents) {
+        const std::vector<std::string_view> words = SplitIntoWords(document.text);
+        std::map<std::string, double> word_freqs;
+        for (std::string_view word : words) {
+            word_freqs[std::string(word)] += 1.0 / words.size();
+        }
+        document_word_freqs.push_back(std::move(word_freqs));
+    }
+    // Суммарная частота слов документа, совпадающих со словом запроса или с префиксом (cat*)
+    const auto get_term_freq = [](const std::map<std::string, double>& word_freqs, const std::string& term) {
+        if (term.back() != '*') {
+            const auto found = word_freqs.find(term);
+            return found == word_freqs.end() ? 0.0 : found->second;
+        }
+        const std::string prefix = term.substr(0, term.size() - 1);
+        double term_freq = 0.0;
+        for (auto it = word_freqs.lower_bound(prefix); it != word_freqs.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            term_freq += it->second;
+        }
+        return term_freq;
+    };
+
+    int non_empty_result_count = 0;
+    for (const std::string& query : GenerateTestQueries(300, 18, 0.1)) {
+        std::set<std::string> plus_terms;
+        std::set<std::string> minus_terms;
+        for (std::string_view word : SplitIntoWords(query)) {
+            if (word[0] == '-') {
+                minus_terms.insert(std::string(word.substr(1)));
+            } else {
+                plus_terms.insert(std::string(word));
+            }
+        }
+
+        // Запрос из одних минус-слов ничего не находит
+        std::map<std::string, int> term_document_counts;
+        std::vector<bool> is_matched(documents.size(), !plus_terms.empty());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            for (const std::string& term : plus_terms) {
+                if (get_term_freq(document_word_freqs[i], term) > 0.0) {
+                    ++term_document_counts[term];
+                } else {
+                    is_matched[i] = false;
+                }
+            }
+            for (const std::string& term : minus_terms) {
+                if (get_term_freq(document_word_freqs[i], term) > 0.0) {
+                    is_matched[i] = false;
+                }
+            }
+        }
+
+        std::vector<Document> expected;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            if (!is_matched[i] || documents[i].status != DocumentStatus::ACTUAL) {
+                continue;
+            }
+            double relevance = 0.0;
+            for (const std::string& term : plus_terms) {
+                relevance += get_term_freq(document_word_freqs[i], term) * std::log(document_count / term_document_counts.at(term));
+            }
+            const std::vector<int>& ratings = documents[i].ratings;
+            const int rating = std::accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
+            expected.push_back({documents[i].id, relevance, rating});
+        }
+        SortAndTruncate(std::execution::seq, expected);
+        if (!expected.empty()) {
+            ++non_empty_result_count;
+        }
+
+        const PreparedQuery prepared_query = search_server.PrepareQuery(query, QueryMode::ALL);
+        CheckTest(AreDocumentsEqual(search_server.FindTopDocuments(prepared_query), expected),
+                  "режим ALL находит документы со всеми плюс-словами и без минус-слов: "s + query);
+        for (size_t i = 0; i < documents.size(); i += 97) {
+            CheckTest(std::get<0>(search_server.MatchDocument(prepared_query, documents[i].id)).empty() != is_matched[i],
+                      "MatchDocument в режиме ALL совпадает с эталоном: "s + query);
+        }
+    }
+    CheckTest(non_empty_result_count > 0, "среди запросов есть запросы с результатами"s);
+
+    // Плюс-слово без документов: пересечение пусто сразу, в том числе если все документы слова удалены
+    search_server.AddDocument(100000, "rare w1"s, DocumentStatus::ACTUAL, {1});
+    search_server.RemoveDocument(100000);
+    for (const std::string& query : {"w1 nosuchword"s, "w1 nosuch*"s, "w1 rare"s}) {
+        CheckTest(!search_server.FindTopDocuments(search_server.PrepareQuery(query)).empty()
+                      && search_server.FindTopDocuments(search_server.PrepareQuery(query, QueryMode::ALL)).empty(),
+                  "режим ALL ничего не находит, если у плюс-слова нет документов: "s + query);
+    }
+}
+
+void TestPreparedQuery() {
+    SearchServer search_server("w0"s);
+    const std::vector<GeneratedDocument> documents = GenerateTestDocuments(500, 15);
+    for (const GeneratedDocument& document : documents) {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    ThreadPool thread_pool(2);
+
+    // Один подготовленный запрос, выполненный с разными статусами, предикатами и фильтрами,
+    // даёт то же, что запрос, подготовленный заново для каждого вызова
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    const auto filter = StatusEquals(DocumentStatus::ACTUAL) && RatingBetween(0, 5);
+    for (const std::string& query : GenerateTestQueries(50, 16, 0.3)) {
+        for (const QueryMode mode : {QueryMode::ANY, QueryMode::ALL}) {
+            const PreparedQuery prepared_query = search_server.PrepareQuery(query, mode);
+            for (int repeat = 0; repeat < 2; ++repeat) {
+                for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT}) {
+                    CheckTest(AreDocumentsEqual(search_server.FindTopDocuments(prepared_query, status),
+                                                search_server.FindTopDocuments(search_server.PrepareQuery(query, mode), status))
+                                  && AreDocumentsEqual(search_server.FindTopDocuments(thread_pool, prepared_query, status),
+                                                       search_server.FindTopDocuments(search_server.PrepareQuery(query, mode), status)),
+                              "повторно выполненный подготовленный запрос совпадает с новым (статус): "s + query);
+                }
+                CheckTest(AreDocumentsEqual(search_server.FindTopDocuments(prepared_query, is_even),
+                                            search_server.FindTopDocuments(search_server.PrepareQuery(query, mode), is_even))
+                              && AreDocumentsEqual(search_server.FindTopDocuments(prepared_query, filter),
+                                                   search_server.FindTopDocuments(search_server.PrepareQuery(query, mode), filter)),
+                          "повторно выполненный подготовленный запрос совпадает с новым (предикат): "s + query);
+            }
+            if (mode == QueryMode::ANY) {
+                CheckTest(AreDocumentsEqual(search_server.FindTopDocuments(prepared_query, DocumentStatus::BANNED),
+                                            search_server.FindTopDocuments(query, DocumentStatus::BANNED)),
+                          "подготовленный запрос совпадает с поиском по строке: "s + query);
+            }
+        }
+    }
+
+    // Устаревший или чужой запрос отвергается всеми способами выполнения
+    const auto is_rejected = [&thread_pool](const SearchServer& server, const PreparedQuery& prepared_query, int document_id) {
+        const auto throws_logic_error = [](auto func) {
+            try {
+                func();
+            } catch (const std::logic_error&) {
+                return true;
+            }
+            return false;
+        };
+        return throws_logic_error([&] { server.FindTopDocuments(prepared_query); })
+            && throws_logic_error([&] { server.FindTopDocuments(thread_pool, prepared_query); })
+            && throws_logic_error([&] { server.MatchDocument(prepared_query, document_id); });
+    };
+
+    SearchServer other_server("w0"s);
+    other_server.AddDocument(documents[0].id, documents[0].text, documents[0].status, documents[0].ratings);
+    CheckTest(is_rejected(other_server, search_server.PrepareQuery("w1 w2"s), documents[0].id),
+              "запрос, подготовленный другим сервером, отвергается"s);
+
+    const PreparedQuery before_add = search_server.PrepareQuery("w1 w2"s);
+    search_server.AddDocument(100000, "w1 w2"s, DocumentStatus::ACTUAL, {1});
+    CheckTest(is_rejected(search_server, before_add, documents[0].id), "запрос, подготовленный до AddDocument, отвергается"s);
+
+    const PreparedQuery before_remove = search_server.PrepareQuery("w1 w2"s);
+    search_server.RemoveDocument(100000);
+    CheckTest(is_rejected(search_server, before_remove, documents[0].id), "запрос, подготовленный до RemoveDocument, отвергается"s);
+
+    const PreparedQuery before_compact = search_server.PrepareQuery("w1 w2"s);
+    search_server.Compact();
+    CheckTest(is_rejected(search_server, before_compact, documents[0].id), "запрос, подготовленный до Compact, отвергается"s);
+
+    const PreparedQuery after_compact = search_server.PrepareQuery("w1 w2"s);
+    CheckTest(!is_rejected(search_server, after_compact, documents[0].id)
+                  && AreDocumentsEqual(search_server.FindTopDocuments(after_compact), search_server.FindTopDocuments("w1 w2"s)),
+              "запрос, подготовленный после изменений, выполняется"s);
+}
+
+void TestThreadPool() {
+    // Ошибочный номер процессора отвергается до запуска потоков
+    std::vector<std::vector<int>> invalid_affinities = {{-1}, {0, -5}};
+#ifdef __linux__
+    invalid_affinities.push_back({CPU_SETSIZE});
+    invalid_affinities.push_back({1 << 20});
+#endif
+    for (const std::vector<int>& cpu_affinity : invalid_affinities) {
+        bool is_rejected = false;
+        try {
+            ThreadPool thread_pool(2, cpu_affinity);
+        } catch (const std::invalid_argument&) {
+            is_rejected = true;
+        }
+        CheckTest(is_rejected, "пул отвергает недопустимый номер процессора"s);
+    }
+
+    // Небольшая работа выполняется в вызывающем потоке
+    ThreadPool thread_pool(2);
+    const std::thread::id caller_id = std::this_thread::get_id();
+    std::atomic<bool> is_inline = true;
+    thread_pool.ParallelFor(100, ThreadPool::DEFAULT_INLINE_THRESHOLD - 1, [&](size_t) {
+        if (std::this_thread::get_id() != caller_id) {
+            is_inline = false;
+        }
+    });
+    CheckTest(is_inline, "работа ниже порога выполняется в вызывающем потоке"s);
+
+    // Без порога работа расходится по потокам; исключение из тела доходит до вызывающего,
+    // и пул остаётся пригодным
+    ThreadPool eager_pool(2, {}, 0);
+    for (ThreadPool* pool : {&thread_pool, &eager_pool}) {
+        bool is_rethrown = false;
+        try {
+            pool->ParallelFor(1000, 1000000, [](size_t i) {
+                if (i == 537) {
+                    throw std::runtime_error("ошибка в теле цикла"s);
+                }
+            });
+        } catch (const std::runtime_error& error) {
+            is_rethrown = error.what() == "ошибка в теле цикла"s;
+        }
+        CheckTest(is_rethrown, "исключение из ParallelFor доходит до вызывающего"s);
+        CheckTest(pool->Submit([] { return 42; }).get() == 42, "после исключения пул продолжает работать"s);
+    }
+
+    // Пул без потоков выполняет всё в вызывающем потоке
+    ThreadPool empty_pool(0);
+    std::vector<size_t> values(10000);
+    empty_pool.ParallelFor(values.size(), 1000000, [&values, caller_id](size_t i) {
+        values[i] = std::this_thread::get_id() == caller_id ? i : 0;
+    });
+    CheckTest(empty_pool.GetThreadCount() == 0 && std::accumulate(values.begin(), values.end(), size_t(0)) == values.size() * (values.size() - 1) / 2
+                  && empty_pool.Submit([] { return 7; }).get() == 7,
+              "пул без потоков выполняет работу сам"s);
+
+    // Вложенные вызовы не блокируют пул, даже если в нём один поток
+    ThreadPool single_pool(1, {}, 0);
+    for (ThreadPool* pool : {&single_pool, &eager_pool}) {
+        std::atomic<size_t> call_count = 0;
+        pool->ParallelFor(16, 1000000, [pool, &call_count](size_t) {
+            pool->ParallelFor(100, 1000000, [&call_count](size_t) {
+                ++call_count;
+            });
+        });
+        CheckTest(call_count == 1600, "вложенные ParallelFor завершаются"s);
+    }
+}
+
+void TestSearchServer() {
+    DifferentialTestConfig config;
+    config.document_count = 2000;
+    config.dictionary_size = 2000;
+    config.query_count = 200;
+    config.removed_document_count = 50;
+    config.max_thread_count = std::min<size_t>(config.max_thread_count, 4);
+    TestParallelVersionsMatchSequential(config);
+
+    TestDeadlineSearch();
+    TestAsyncSearchServer();
+    TestLoadCorpus();
+    TestAddDocumentsBatch();
+    TestPrefixQuery();
+    TestCompact();
+    TestSegmentedSearchServer();
+    TestDocumentTextStore();
+    TestDocumentFilters();
+    TestIndexLog();
+    TestConjunctiveQueryMode();
+    TestPreparedQuery();
+    TestThreadPool();
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+// Параметры случайного корпуса и набора запросов для сравнения версий методов
+struct DifferentialTestConfig {
+    int document_count = 20000;
+    // Слова выбираются из словаря неравномерно: частые слова дают длинные списки документов
+    int dictionary_size = 10000;
+    int max_document_word_count = 50;
+    int query_count = 2000;
+    int max_query_word_count = 8;
+    double minus_word_probability = 0.2;
+    double prefix_word_probability = 0.05;
+    // Сколько документов удаляется при сравнении версий RemoveDocument
+    int removed_document_count = 200;
+    // Кривая ускорения снимается для 1, 2, 4, ... max_thread_count потоков
+    size_t max_thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // Снимать ли кривую ускорения. Замеры долгие, поэтому тесты их не включают (см. benchmark/main.cpp)
+    bool measure_speedup = false;
+    uint32_t seed = 42;
+};
+
+// Время выполнения всех запросов набора одной версией метода
+struct SpeedupPoint {
+    std::string operation;
+    // "seq", "par" или "pool"
+    std::string context;
+    // Для "par" — число потоков по умолчанию
+    size_t thread_count = 1;
+    double seconds = 0.0;
+    // Отношение времени последовательной версии к времени этой
+    double speedup = 1.0;
+};
+
+struct DifferentialTestReport {
+    int checked_count = 0;
+    int mismatch_count = 0;
+    // Описания первых расхождений
+    std::vector<std::string> mismatches;
+    std::vector<SpeedupPoint> speedup_curve;
+};
+
+// Прогоняет случайный корпус и набор запросов через seq, par и ThreadPool версии
+// FindTopDocuments (в обоих режимах QueryMode), MatchDocument, RemoveDocument и ProcessQueries,
+// сравнивая результаты с последовательной версией (релевантность — с точностью
+// MIN_COMPARISON_TOLERANCE), и при config.measure_speedup замеряет ускорение параллельных версий
+DifferentialTestReport RunDifferentialTest(const DifferentialTestConfig& config = {});
+
+// Печатает итог сверки и кривую ускорения, если она снималась. Форматирование out не меняется
+void PrintDifferentialTestReport(const DifferentialTestReport& report, std::ostream& out = std::cout);
+
+// Запускает RunDifferentialTest и выбрасывает std::logic_error, если версии разошлись
+void TestParallelVersionsMatchSequential(const DifferentialTestConfig& config = {});
+
+// Проверки поведения; при ошибке выбрасывают std::logic_error с описанием проверки
+void TestDeadlineSearch();
+void TestAsyncSearchServer();
+void TestLoadCorpus();
+// Пачка AddDocuments с повторным ID или недопустимым текстом не добавляет ни одного документа
+void TestAddDocumentsBatch();
+void TestPrefixQuery();
+void TestCompact();
+// Результаты SegmentedSearchServer совпадают с SearchServer после слияний и удалений
+void TestSegmentedSearchServer();
+void TestDocumentTextStore();
+// Блочные фильтры document_filter.h совпадают с эквивалентными предикатами
+void TestDocumentFilters();
+// Воспроизведение журнала индекса, в том числе оборванного и повреждённого
+void TestIndexLog();
+// Режим QueryMode::ALL сверяется с эталоном, который перебирает все документы
+void TestConjunctiveQueryMode();
+// Подготовленный запрос выполняется повторно как новый, а устаревший или чужой отвергается
+void TestPreparedQuery();
+void TestThreadPool();
+
+// Запускает все тесты сервера на небольших данных; при ошибке выбрасывает std::logic_error
+void TestSearchServer();
@@ -0,0 +1,179 @@
+#include "thread_pool.h"
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace {
+
+// Номер очереди текущего рабочего потока; у посторонних потоков очереди нет
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_queue_index = 0;
+
+// Номера процессоров проверяются до запуска потоков, чтобы ошибка в списке не оставляла пул полузапущенным
+void CheckCpuAffinity(const std::vector<int>& cpu_affinity) {
+    if (cpu_affinity.empty()) {
+        return;
+    }
+#ifdef __linux__
+    // Процессоры, на которых процессу разрешено выполняться (с учётом taskset, cgroups и т.п.)
+    cpu_set_t available_cpus;
+    CPU_ZERO(&available_cpus);
+    if (sched_getaffinity(0, sizeof(available_cpus), &available_cpus) != 0) {
+        throw std::system_error(errno, std::generic_category(), "Не удалось получить список доступных процессоров"s);
+    }
+#endif
+    for (const int cpu : cpu_affinity) {
+        if (cpu < 0) {
+            throw std::invalid_argument("Номер процессора не может быть отрицательным: "s + std::to_string(cpu));
+        }
+#ifdef __linux__
+        if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &available_cpus)) {
+            throw std::invalid_argument("Процессор "s + std::to_string(cpu) + " недоступен процессу"s);
+        }
+#endif
+    }
+}
+
+void PinThread(std::thread& thread, int cpu) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    const int error = pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+    if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "Не удалось привязать рабочий поток к процессору "s + std::to_string(cpu));
+    }
+#else
+    (void)thread;
+    (void)cpu;
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t thread_count, std::vector<int> cpu_affinity, size_t inline_threshold)
+    : inline_threshold_(inline_threshold) {
+    CheckCpuAffinity(cpu_affinity);
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    workers_.reserve(thread_count);
+    // Потоки привязываются из конструктора, чтобы сбой привязки дошёл до вызывающего.
+    // Деструктор при исключении из конструктора не вызывается, поэтому запущенные потоки останавливаются здесь
+    try {
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back([this, i] { WorkerLoop(i); });
+            if (!cpu_affinity.empty()) {
+                PinThread(workers_.back(), cpu_affinity[i % cpu_affinity.size()]);
+            }
+        }
+    } catch (...) {
+        StopWorkers();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    StopWorkers();
+}
+
+void ThreadPool::StopWorkers() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers_.size();
+}
+
+void ThreadPool::Push(std::function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+    // Задачи рабочего потока кладутся в его собственную очередь, остальные — по кругу
+    const size_t queue_index = current_pool == this
+        ? current_queue_index
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    // Счётчик увеличивается заранее, чтобы не уйти в минус, если задачу перехватят сразу
+    queued_task_count_.fetch_add(1);
+    {
+        std::lock_guard lock(queues_[queue_index]->mutex);
+        queues_[queue_index]->tasks.push_back(std::move(task));
+    }
+    // Засыпающий поток увеличивает sleeping_count_ до проверки queued_task_count_,
+    // поэтому либо он увидит задачу, либо здесь увидят его и разбудят под блокировкой
+    if (sleeping_count_.load() > 0) {
+        std::lock_guard lock(sleep_mutex_);
+        sleep_cv_.notify_one();
+    }
+}
+
+bool ThreadPool::TryPop(size_t queue_index, bool from_back, std::function<void()>& task) {
+    WorkerQueue& queue = *queues_[queue_index];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    if (from_back) {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+    } else {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+    }
+    return true;
+}
+
+bool ThreadPool::TryRunTask() {
+    if (queues_.empty()) {
+        return false;
+    }
+    const bool is_worker = current_pool == this;
+    const size_t own_index = is_worker ? current_queue_index : 0;
+
+    std::function<void()> task;
+    bool found = is_worker && TryPop(own_index, true, task);
+    for (size_t offset = 1; !found && offset <= queues_.size(); ++offset) {
+        found = TryPop((own_index + offset) % queues_.size(), false, task);
+    }
+    if (!found) {
+        return false;
+    }
+    queued_task_count_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::WorkerLoop(size_t index) {
+    current_pool = this;
+    current_queue_index = index;
+    while (true) {
+        if (TryRunTask()) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        sleeping_count_.fetch_add(1);
+        sleep_cv_.wait(lock, [this] { return stopping_ || queued_task_count_.load() > 0; });
+        sleeping_count_.fetch_sub(1, std::memory_order_relaxed);
+        if (stopping_ && queued_task_count_.load() == 0) {
+            return;
+        }
+    }
+}
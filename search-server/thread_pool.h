@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом задач: у каждого рабочего потока своя очередь,
+// свои задачи он берёт с конца, а простаивая — забирает чужие с начала.
+// Используется как контекст выполнения параллельных перегрузок SearchServer
+class ThreadPool {
+public:
+    // Объём работы (в элементах), ниже которого ParallelFor выполняется в вызывающем потоке
+    static constexpr size_t DEFAULT_INLINE_THRESHOLD = 4096;
+
+    // cpu_affinity — номера процессоров, к которым по кругу привязываются рабочие потоки;
+    // пустой список — без привязки. Привязка поддерживается только в Linux.
+    // Отрицательный или недоступный процессу номер — std::invalid_argument,
+    // сбой самой привязки — std::system_error
+    explicit ThreadPool(size_t thread_count,
+                        std::vector<int> cpu_affinity = {},
+                        size_t inline_threshold = DEFAULT_INLINE_THRESHOLD);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Дожидается выполнения уже поставленных задач
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // Вызывает func(i) для всех i из [0, count) и ждёт завершения.
+    // work_estimate — оценка общего объёма работы: если она меньше порога,
+    // цикл выполняется в вызывающем потоке без накладных расходов на планирование.
+    // Вызывающий поток тоже выполняет задачи, поэтому вложенные вызовы не блокируют пул.
+    // Первое выброшенное исключение пробрасывается после завершения всех частей
+    template <typename Func>
+    void ParallelFor(size_t count, size_t work_estimate, Func func);
+
+    // Ставит задачу в очередь и возвращает её результат через std::future
+    template <typename Func>
+    auto Submit(Func func) -> std::future<decltype(func())>;
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    const size_t inline_threshold_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_ = 0;
+
+    // Счётчики меняются без блокировки; sleep_mutex_ берётся, только чтобы уснуть или разбудить
+    std::atomic<size_t> queued_task_count_ = 0;
+    std::atomic<size_t> sleeping_count_ = 0;
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ = false;
+
+    void Push(std::function<void()> task);
+
+    // Выполняет одну задачу: свою (если вызван из рабочего потока) или перехваченную
+    bool TryRunTask();
+    bool TryPop(size_t queue_index, bool from_back, std::function<void()>& task);
+
+    void WorkerLoop(size_t index);
+    // Дожидается выполнения поставленных задач и завершает рабочие потоки
+    void StopWorkers();
+};
+
+template <typename Func>
+void ThreadPool::ParallelFor(size_t count, size_t work_estimate, Func func) {
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || work_estimate < inline_threshold_ || workers_.empty()) {
+        for (size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    // Несколько частей на поток, чтобы было что перехватывать при неравномерной нагрузке
+    const size_t part_count = std::min(count, workers_.size() * 4);
+    const size_t part_size = (count + part_count - 1) / part_count;
+
+    // Части, которые ещё не завершились; защищено state_mutex
+    size_t remaining = (count + part_size - 1) / part_size;
+    std::exception_ptr first_exception;
+    std::mutex state_mutex;
+    std::condition_variable done_cv;
+
+    const auto run_part = [&](size_t begin, size_t end) {
+        std::exception_ptr exception;
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                func(i);
+            }
+        } catch (...) {
+            exception = std::current_exception();
+        }
+        std::lock_guard lock(state_mutex);
+        if (exception && !first_exception) {
+            first_exception = exception;
+        }
+        if (--remaining == 0) {
+            done_cv.notify_all();
+        }
+    };
+
+    // Первую часть выполняет вызывающий поток, остальные уходят в пул
+    for (size_t begin = part_size; begin < count; begin += part_size) {
+        const size_t end = std::min(begin + part_size, count);
+        Push([&run_part, begin, end] { run_part(begin, end); });
+    }
+    run_part(0, std::min(part_size, count));
+
+    // Пока в очередях есть задачи, вызывающий поток помогает их выполнять.
+    // Когда очереди пусты, оставшиеся части уже выполняются другими потоками — ждём их без опроса
+    std::unique_lock lock(state_mutex);
+    while (remaining > 0) {
+        lock.unlock();
+        const bool has_run_task = TryRunTask();
+        lock.lock();
+        if (!has_run_task) {
+            done_cv.wait(lock, [&remaining] { return remaining == 0; });
+        }
+    }
+    lock.unlock();
+
+    if (first_exception) {
+        std::rethrow_exception(first_exception);
+    }
+}
+
+template <typename Func>
+auto ThreadPool::Submit(Func func) -> std::future<decltype(func())> {
+    using Result = decltype(func());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+    std::future<Result> result = task->get_future();
+    Push([task] { (*task)(); });
+    return result;
+}